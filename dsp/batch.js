@@ -0,0 +1,200 @@
+// A compact binary encoding for the renderer's instruction batches.
+//
+// Rather than JSON.stringify the batch, only for the native side to parse it back
+// again, we write it straight into an ArrayBuffer which crosses into native code
+// without a copy, and which the native side decodes directly into the values that
+// the runtime applies (see native/InstructionCodec.h for the format).
+//
+// Everything is little-endian. Each instruction is an opcode byte followed by its
+// operands, with node ids as int32, strings as a uint32 byte length and UTF-8, and
+// property values as a tag byte followed by the value.
+const Tag = {
+  Undefined: 0,
+  Null: 1,
+  False: 2,
+  True: 3,
+  Number: 4,
+  String: 5,
+  Array: 6,
+  Object: 7,
+  Float32Array: 8,
+};
+
+class Writer {
+  constructor(capacity) {
+    this.buffer = new ArrayBuffer(capacity);
+    this.view = new DataView(this.buffer);
+    this.bytes = new Uint8Array(this.buffer);
+    this.length = 0;
+  }
+
+  reserve(n) {
+    if (this.length + n <= this.buffer.byteLength)
+      return;
+
+    let capacity = this.buffer.byteLength * 2;
+
+    while (capacity < this.length + n)
+      capacity *= 2;
+
+    const next = new ArrayBuffer(capacity);
+    new Uint8Array(next).set(this.bytes.subarray(0, this.length));
+
+    this.buffer = next;
+    this.view = new DataView(next);
+    this.bytes = new Uint8Array(next);
+  }
+
+  u8(v) {
+    this.reserve(1);
+    this.view.setUint8(this.length, v);
+    this.length += 1;
+  }
+
+  i32(v) {
+    this.reserve(4);
+    this.view.setInt32(this.length, v, true);
+    this.length += 4;
+  }
+
+  u32(v) {
+    this.reserve(4);
+    this.view.setUint32(this.length, v, true);
+    this.length += 4;
+  }
+
+  f32(v) {
+    this.reserve(4);
+    this.view.setFloat32(this.length, v, true);
+    this.length += 4;
+  }
+
+  f64(v) {
+    this.reserve(8);
+    this.view.setFloat64(this.length, v, true);
+    this.length += 8;
+  }
+
+  // QuickJS has no TextEncoder, so we write UTF-8 ourselves. Node types and prop
+  // keys are ASCII in practice, which makes this a byte copy.
+  string(s) {
+    this.reserve(4 + s.length * 3);
+
+    const start = this.length;
+    let i = start + 4;
+
+    for (let k = 0; k < s.length; ++k) {
+      let c = s.charCodeAt(k);
+
+      if (c >= 0xd800 && c < 0xdc00 && k + 1 < s.length) {
+        const d = s.charCodeAt(k + 1);
+
+        if (d >= 0xdc00 && d < 0xe000) {
+          c = 0x10000 + ((c - 0xd800) << 10) + (d - 0xdc00);
+          ++k;
+        }
+      }
+
+      if (c < 0x80) {
+        this.bytes[i++] = c;
+      } else if (c < 0x800) {
+        this.bytes[i++] = 0xc0 | (c >> 6);
+        this.bytes[i++] = 0x80 | (c & 0x3f);
+      } else if (c < 0x10000) {
+        this.bytes[i++] = 0xe0 | (c >> 12);
+        this.bytes[i++] = 0x80 | ((c >> 6) & 0x3f);
+        this.bytes[i++] = 0x80 | (c & 0x3f);
+      } else {
+        this.bytes[i++] = 0xf0 | (c >> 18);
+        this.bytes[i++] = 0x80 | ((c >> 12) & 0x3f);
+        this.bytes[i++] = 0x80 | ((c >> 6) & 0x3f);
+        this.bytes[i++] = 0x80 | (c & 0x3f);
+      }
+    }
+
+    this.view.setUint32(start, i - start - 4, true);
+    this.length = i;
+  }
+
+  value(v) {
+    if (v === undefined) {
+      this.u8(Tag.Undefined);
+    } else if (v === null) {
+      this.u8(Tag.Null);
+    } else if (typeof v === 'boolean') {
+      this.u8(v ? Tag.True : Tag.False);
+    } else if (typeof v === 'number') {
+      this.u8(Tag.Number);
+      this.f64(v);
+    } else if (typeof v === 'string') {
+      this.u8(Tag.String);
+      this.string(v);
+    } else if (v instanceof Float32Array) {
+      this.u8(Tag.Float32Array);
+      this.u32(v.length);
+
+      for (let i = 0; i < v.length; ++i)
+        this.f32(v[i]);
+    } else if (Array.isArray(v)) {
+      this.u8(Tag.Array);
+      this.u32(v.length);
+
+      for (let i = 0; i < v.length; ++i)
+        this.value(v[i]);
+    } else {
+      const entries = Object.entries(v);
+
+      this.u8(Tag.Object);
+      this.u32(entries.length);
+
+      for (let [k, x] of entries) {
+        this.string(k);
+        this.value(x);
+      }
+    }
+  }
+}
+
+// Encodes a batch of instructions as handed to the Renderer's callback, returning
+// an ArrayBuffer of exactly the encoded length.
+export function encodeBatch(batch) {
+  const w = new Writer(Math.max(256, batch.length * 24));
+
+  for (let ins of batch) {
+    const [type, ...args] = ins;
+    w.u8(type);
+
+    switch (type) {
+      case 0: // [0, nodeId, type]
+        w.i32(args[0]);
+        w.string(args[1]);
+        break;
+      case 1: // [1, nodeId]
+        w.i32(args[0]);
+        break;
+      case 2: // [2, parentId, childId, childOutputChannel]
+        w.i32(args[0]);
+        w.i32(args[1]);
+        w.i32(args[2] ?? 0);
+        break;
+      case 3: // [3, nodeId, key, value]
+        w.i32(args[0]);
+        w.string(args[1]);
+        w.value(args[2]);
+        break;
+      case 4: // [4, [nodeId, ...]]
+        w.u32(args[0].length);
+
+        for (let id of args[0])
+          w.i32(id);
+
+        break;
+      case 5: // [5]
+        break;
+      default:
+        throw new Error(`Unknown instruction type ${type}`);
+    }
+  }
+
+  return w.buffer.slice(0, w.length);
+}
@@ -1,59 +1,91 @@
-import {Renderer, el} from '@elemaudio/core';
-import {RefMap} from './RefMap';
+import {Renderer, el, createNode} from '@elemaudio/core';
+import {encodeBatch} from './batch';
 import srvb from './srvb';
 
 
 // This project demonstrates writing a small FDN reverb effect in Elementary.
 //
 // First, we initialize a custom Renderer instance that marshals our instruction
-// batches through the __postNativeMessage__ function to direct the underlying native
-// engine.
-let core = new Renderer((batch) => {
-  __postNativeMessage__(JSON.stringify(batch));
-});
+// batches to direct the underlying native engine. Where the native side offers
+// __postNativeBatch__ we hand batches over in a compact binary encoding, and
+// otherwise as JSON through __postNativeMessage__. Either way the native side
+// answers each batch with stats from its graph fusion pass, which we hold onto
+// for logging alongside the render stats.
+let nativeStats = {};
 
-// Next, a RefMap for coordinating our refs
-let refs = new RefMap(core);
+function createRenderer() {
+  return new Renderer((batch) => {
+    const stats = (typeof globalThis.__postNativeBatch__ === 'function')
+      ? __postNativeBatch__(encodeBatch(batch))
+      : __postNativeMessage__(JSON.stringify(batch));
+
+    nativeStats = stats ?? {};
+  });
+}
+
+let core = createRenderer();
+
+// Parameter values reach the graph through native `param` nodes, which read the
+// host's values directly on the audio thread, so automation never has to come
+// through here.
+const param = (paramId) => createNode('param', {paramId}, []);
 
 // Holding onto the previous state allows us a quick way to differentiate
-// when we need to fully re-render versus when we can just update refs
+// when we need to re-render the graph
 let prevState = null;
 
 function shouldRender(prevState, nextState) {
-  return (prevState === null) || (prevState.sampleRate !== nextState.sampleRate);
+  return (prevState === null)
+    || (prevState.sampleRate !== nextState.sampleRate)
+    || (prevState.channels !== nextState.channels)
+    || (prevState.fastMath !== nextState.fastMath)
+    || (prevState.wetRate !== nextState.wetRate)
+    || (prevState.quality !== nextState.quality);
 }
 
 // The important piece: here we register a state change callback with the native
-// side. This callback will be hit with the current processor state any time that
-// state changes.
+// side. This callback will be hit with an object of whichever state keys changed,
+// which we merge over what we already had.
 //
-// Given the new state, we simply update our refs or perform a full render depending
-// on the result of our `shouldRender` check.
-globalThis.__receiveStateChange__ = (serializedState) => {
-  const state = JSON.parse(serializedState);
+// Given the new state, we perform a full render if the result of our `shouldRender`
+// check says the structure of the graph needs to change. The graph has one input
+// and one output per channel of the host's output layout; with fewer inputs than
+// that, the extra channels read silence and carry only the wet signal. A mono output
+// keeps the stereo graph, of which the runtime only writes the left side.
+globalThis.__receiveStateChange__ = (changes) => {
+  const state = {...prevState, ...changes};
 
   if (shouldRender(prevState, state)) {
+    const channels = Math.max(2, state.channels ?? 2);
+    const inputs = Array.from({length: channels}, (_, channel) => el.in({channel}));
+
     let stats = core.render(...srvb({
       key: 'srvb',
       sampleRate: state.sampleRate,
-      size: refs.getOrCreate('size', 'const', {value: state.size}, []),
-      decay: refs.getOrCreate('decay', 'const', {value: state.decay}, []),
-      mod: refs.getOrCreate('mod', 'const', {value: state.mod}, []),
-      mix: refs.getOrCreate('mix', 'const', {value: state.mix}, []),
-    }, el.in({channel: 0}), el.in({channel: 1})));
-
-    console.log(stats);
-  } else {
-    console.log('Updating refs');
-    refs.update('size', {value: state.size});
-    refs.update('decay', {value: state.decay});
-    refs.update('mod', {value: state.mod});
-    refs.update('mix', {value: state.mix});
+      size: param('size'),
+      decay: param('decay'),
+      mod: param('mod'),
+      mix: param('mix'),
+      lines: 4 * 2 ** Math.round(state.quality ?? 1),
+      decimation: 2 ** Math.round(state.wetRate ?? 0),
+      fastMath: Boolean(state.fastMath),
+    }, ...inputs));
+
+    console.log({...stats, ...nativeStats});
   }
 
   prevState = state;
 };
 
+// When the sample rate changes, or the host resets us, the native side swaps in a
+// fresh, empty runtime but keeps this engine. A fresh renderer forgets the graph we
+// rendered into the old one, and forgetting the previous state makes sure that the
+// full state dispatch that follows renders the whole graph again.
+globalThis.__receiveRuntimeReset__ = () => {
+  core = createRenderer();
+  prevState = null;
+};
+
 // NOTE: This is highly experimental and should not yet be relied on
 // as a consistent feature.
 //
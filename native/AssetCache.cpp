@@ -0,0 +1,150 @@
+#include "AssetCache.h"
+
+#include <map>
+#include <mutex>
+
+#if ELEM_EMBED_ASSETS
+ #include <BinaryData.h>
+#endif
+
+
+namespace
+{
+    //==============================================================================
+    // Every cache we've loaded in this process, by assets directory. They live as
+    // long as the process does, so closing the last editor doesn't throw anything away.
+    std::mutex cachesLock;
+
+    std::map<std::string, std::shared_ptr<AssetCache const>>& getCaches()
+    {
+        static std::map<std::string, std::shared_ptr<AssetCache const>> caches;
+        return caches;
+    }
+
+    std::string normalisePath(std::string const& path)
+    {
+        if (path.empty() || path == "/")
+            return "index.html";
+
+        return (path[0] == '/') ? path.substr(1) : path;
+    }
+}
+
+//==============================================================================
+std::shared_ptr<AssetCache const> AssetCache::get (juce::File const& directory)
+{
+#if ELEM_EMBED_ASSETS
+    // Embedded assets are the same wherever we're asked to look
+    auto const key = std::string();
+#else
+    auto const key = directory.getFullPathName().toStdString();
+#endif
+
+    std::lock_guard<std::mutex> lock(cachesLock);
+    auto& caches = getCaches();
+
+    if (auto it = caches.find(key); it != caches.end())
+        return it->second;
+
+    std::shared_ptr<AssetCache> cache(new AssetCache());
+
+#if ELEM_EMBED_ASSETS
+    juce::ignoreUnused(directory);
+    cache->loadEmbedded();
+#else
+    cache->loadDirectory(directory);
+#endif
+
+    caches[key] = cache;
+    return cache;
+}
+
+//==============================================================================
+AssetCache::Asset const* AssetCache::find (std::string const& path) const
+{
+    auto const relativePath = normalisePath(path);
+
+    if (auto it = assets.find(relativePath); it != assets.end())
+        return &it->second;
+
+    // Embedded assets only keep their file names, which our bundler makes unique by
+    // hashing them
+#if ELEM_EMBED_ASSETS
+    auto const slash = relativePath.find_last_of('/');
+
+    if (slash != std::string::npos) {
+        if (auto it = assets.find(relativePath.substr(slash + 1)); it != assets.end())
+            return &it->second;
+    }
+#endif
+
+    return nullptr;
+}
+
+std::string AssetCache::getText (std::string const& path) const
+{
+    if (auto const* asset = find(path))
+        return std::string(reinterpret_cast<char const*>(asset->data), asset->size);
+
+    return {};
+}
+
+std::string AssetCache::getMimeType (std::string const& path)
+{
+    static std::unordered_map<std::string, std::string> const mimeTypes {
+        { ".html",   "text/html" },
+        { ".js",     "application/javascript" },
+        { ".css",    "text/css" },
+        { ".json",   "application/json" },
+        { ".svg",    "image/svg+xml" },
+        { ".png",    "image/png" },
+        { ".ico",    "image/x-icon" },
+        { ".woff2",  "font/woff2" },
+        { ".wasm",   "application/wasm" },
+    };
+
+    auto const dot = path.find_last_of('.');
+
+    if (dot != std::string::npos) {
+        if (auto it = mimeTypes.find(path.substr(dot)); it != mimeTypes.end())
+            return it->second;
+    }
+
+    return "application/octet-stream";
+}
+
+//==============================================================================
+void AssetCache::loadDirectory (juce::File const& directory)
+{
+    juce::Array<juce::File> files;
+
+    for (auto const& entry : juce::RangedDirectoryIterator(directory, true, "*", juce::File::findFiles))
+        files.add(entry.getFile());
+
+    // Sized up front, because assets point into these blocks
+    storage.resize(static_cast<size_t>(files.size()));
+
+    for (int i = 0; i < files.size(); ++i) {
+        auto& mb = storage[static_cast<size_t>(i)];
+
+        if (!files[i].loadFileAsData(mb))
+            continue;
+
+        auto const relativePath = files[i].getRelativePathFrom(directory).replaceCharacter('\\', '/').toStdString();
+        assets[relativePath] = { static_cast<uint8_t const*>(mb.getData()), mb.getSize(), getMimeType(relativePath) };
+    }
+}
+
+void AssetCache::loadEmbedded()
+{
+#if ELEM_EMBED_ASSETS
+    for (int i = 0; i < BinaryData::namedResourceListSize; ++i) {
+        int size = 0;
+        auto const* bytes = reinterpret_cast<uint8_t const*>(BinaryData::getNamedResource(BinaryData::namedResourceList[i], size));
+        std::string const name = BinaryData::originalFilenames[i];
+
+        if (bytes != nullptr)
+            assets[name] = { bytes, static_cast<size_t>(size), getMimeType(name) };
+    }
+#endif
+}
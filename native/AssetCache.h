@@ -0,0 +1,63 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+//==============================================================================
+// The static assets from dist/: the editor, manifest.json and dsp.main.js, held in
+// memory once per process and shared, read only, by every plugin instance.
+//
+// Builds with ELEM_EMBED_ASSETS compile the assets into the binary, and the cache
+// fills from there. Otherwise it reads the assets directory once, on first use, so
+// that opening an editor or building a runtime never touches the disk again.
+//
+// Assets are views onto the embedded data, or onto memory the cache owns, so nothing
+// gets copied on the way out except by whoever needs a copy of their own. Each one
+// carries its MIME type, worked out when it's loaded.
+class AssetCache
+{
+public:
+    struct Asset {
+        uint8_t const* data = nullptr;
+        size_t size = 0;
+        std::string mimeType;
+    };
+
+    //==============================================================================
+    /** Returns the process-wide cache for an assets directory, loading it the first
+        time anyone asks. Safe from any thread.
+    */
+    static std::shared_ptr<AssetCache const> get (juce::File const& directory);
+
+    //==============================================================================
+    /** Looks an asset up by its path relative to the assets directory, with or without
+        a leading slash, where "/" means index.html. Returns nullptr if there's no such asset.
+    */
+    Asset const* find (std::string const& path) const;
+
+    /** Returns an asset's contents as a string, or an empty string if there's no such asset. */
+    std::string getText (std::string const& path) const;
+
+    bool isEmpty() const { return assets.empty(); }
+
+    //==============================================================================
+    static std::string getMimeType (std::string const& path);
+
+private:
+    //==============================================================================
+    AssetCache() = default;
+
+    void loadDirectory (juce::File const& directory);
+    void loadEmbedded();
+
+    std::unordered_map<std::string, Asset> assets;
+    std::vector<juce::MemoryBlock> storage;
+
+    JUCE_DECLARE_NON_COPYABLE (AssetCache)
+};
@@ -0,0 +1,941 @@
+#include "GraphFusion.h"
+#include "PluginProcessor.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+
+#if JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+
+//==============================================================================
+// A headless benchmark for EffectsPluginProcessor::processBlock.
+//
+// Loads the bundled manifest.json and dsp.main.js without any editor, then drives
+// processBlock across a matrix of sample rates, block sizes and instance counts.
+// Each configuration is written as one JSON object per line so that results can
+// be collected and compared per commit. With --lines and --decimation, the matrix
+// also covers each density tier of the wet network, and running it at a reduced
+// internal rate. With --channels, it also covers surround and immersive layouts,
+// which share one network across every channel, reporting the cost per channel
+// alongside the cost per sample frame. With --profile, each configuration also
+// breaks its time down by node, and by stage within the wet network, in
+// nanoseconds per sample.
+//
+// With --transport, it instead measures full graph renders, from the engine's
+// render call to the runtime having applied the batch, once per instruction batch
+// transport.
+//
+// With --fast-math, it instead runs each configuration through the precise and
+// the fast math paths side by side, on the same input, and reports the time each
+// takes and how far the fast path's output strays from the precise path's. It exits
+// non-zero if that's ever more than kFastMathToleranceDb below the output.
+//
+// With --parallel, it instead runs each configuration as an offline render, with
+// and without the wet network pipelined across threads, on the same input, and
+// reports the time each takes. It exits non-zero if their outputs ever differ by so
+// much as a bit.
+//
+// With --whole-block, it instead runs each configuration through processBlock's
+// chunked path, and through the path it took before, which copies the host block
+// aside and runs the runtime over all of it in one go, side by side on the same
+// input. It reports the time each takes, and the allocations each makes inside
+// processBlock.
+//
+// With --instantiation, it instead measures what each instance costs to bring up in
+// a session of many: the time from construction to a rendered graph, and the
+// resident memory each adds, for each of the given instance counts.
+//
+// With --check-fusion, it instead runs a batch in which one fused tree feeds two
+// consumers through the graph fusion pass, and exits non-zero if the rewritten
+// batch ever wires up a node before creating it. It needs no assets.
+//
+// With --check-state, it instead saves a session from one instance and restores it
+// into another, and exits non-zero unless the restored instance plays at the saved
+// parameter values.
+//
+// Usage:
+//   SRVBBenchmark [--assets <dist dir>] [--rates 44100,48000,...] [--blocks 16,32,...]
+//                 [--instances 1,8,...] [--lines 4,8,16] [--decimation 1,2,4] [--channels 2,6,12,16]
+//                 [--seconds <n>]
+//                 [--profile] [--label <string>] [--output <file>]
+//   SRVBBenchmark --transport [--renders <n>] [--assets <dist dir>] [--label <string>] [--output <file>]
+//   SRVBBenchmark --fast-math [--rates ...] [--blocks ...] [--channels ...] [--lines ...] [--decimation ...]
+//                 [--seconds <n>] [--assets <dist dir>] [--label <string>] [--output <file>]
+//   SRVBBenchmark --parallel [--rates ...] [--blocks ...] [--channels ...] [--lines ...] [--decimation ...]
+//                 [--seconds <n>] [--assets <dist dir>] [--label <string>] [--output <file>]
+//   SRVBBenchmark --whole-block [--rates ...] [--blocks ...] [--channels ...] [--lines ...] [--decimation ...]
+//                 [--seconds <n>] [--assets <dist dir>] [--label <string>] [--output <file>]
+//   SRVBBenchmark --instantiation 1,16,64,256 [--assets <dist dir>] [--label <string>] [--output <file>]
+//   SRVBBenchmark --check-fusion
+//   SRVBBenchmark --check-state [--assets <dist dir>]
+
+//==============================================================================
+// We count every heap allocation made while the benchmark is inside processBlock
+static thread_local bool isInsideProcessBlock = false;
+static std::atomic<uint64_t> processBlockAllocations { 0 };
+
+void* operator new (std::size_t size)
+{
+    if (isInsideProcessBlock)
+        processBlockAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete (void* ptr) noexcept { std::free(ptr); }
+void operator delete[] (void* ptr) noexcept { std::free(ptr); }
+void operator delete (void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+//==============================================================================
+static std::vector<int> parseList(juce::ArgumentList const& args, juce::String const& option, std::vector<int> defaults)
+{
+    if (!args.containsOption(option))
+        return defaults;
+
+    std::vector<int> values;
+
+    for (auto const& token : juce::StringArray::fromTokens(args.getValueForOption(option), ",", ""))
+        if (token.getIntValue() > 0)
+            values.push_back(token.getIntValue());
+
+    return values;
+}
+
+static double percentile(std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    auto const index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Sets a parameter, given in its natural range, as the host would
+static void setParameter(juce::AudioProcessor& p, juce::String const& paramId, float value)
+{
+    for (auto* param : p.getParameters())
+        if (auto* pf = dynamic_cast<juce::AudioParameterFloat*>(param); pf != nullptr && pf->paramID == paramId)
+            pf->setValueNotifyingHost(pf->convertTo0to1(value));
+}
+
+// Brings up a processor in the given configuration, with its graph rendered and
+// ready to process
+static std::unique_ptr<EffectsPluginProcessor> createProcessor(double sampleRate, int blockSize, int numChannels, int numLines, int decimation,
+                                                              bool fastMath = false, bool parallel = false, bool wholeBlock = false)
+{
+    auto p = std::make_unique<EffectsPluginProcessor>();
+
+    p->setWholeBlockProcessing(wholeBlock ? blockSize : 0);
+    p->setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+    p->prepareToPlay(sampleRate, blockSize);
+    p->setFastMathEnabled(fastMath);
+    p->setParallelProcessingEnabled(parallel);
+
+    // Quality steps through 4, 8 and 16 lines, and wet rate through full, half
+    // and quarter rate
+    setParameter(*p, "quality", std::log2(static_cast<float>(numLines) / 4.0f));
+    setParameter(*p, "wetRate", std::log2(static_cast<float>(decimation)));
+
+    // There's no message loop running here, so we handle the pending update
+    // ourselves, then wait for the engine thread to render the graph
+    p->handleAsyncUpdate();
+    p->waitForEngine();
+
+    return p;
+}
+
+// Half a second of noise every other second, so that we measure both the driven
+// network and its decaying tail
+static void fillInput(juce::AudioBuffer<float>& buffer, std::mt19937& rng, double sampleRate, uint64_t block)
+{
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    auto const t = static_cast<double>(block * static_cast<uint64_t>(buffer.getNumSamples())) / sampleRate;
+    auto const active = std::fmod(t, 2.0) < 0.5;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int j = 0; j < buffer.getNumSamples(); ++j)
+            buffer.setSample(ch, j, active ? noise(rng) : 0.0f);
+}
+
+//==============================================================================
+struct BenchmarkResult
+{
+    double nsPerSample = 0;
+    double realtimeLoad = 0;
+    std::vector<double> blockTimesUs;
+    uint64_t numBlocks = 0;
+    uint64_t allocations = 0;
+    uint64_t idleBlocks = 0;
+    std::map<std::string, double> profileNsPerSample;
+};
+
+static BenchmarkResult runConfiguration(double sampleRate, int blockSize, int numInstances, int numChannels, int numLines, int decimation, double seconds, bool profile)
+{
+    std::vector<std::unique_ptr<EffectsPluginProcessor>> processors;
+    std::vector<juce::AudioBuffer<float>> buffers;
+    juce::MidiBuffer midi;
+
+    for (int i = 0; i < numInstances; ++i) {
+        processors.push_back(createProcessor(sampleRate, blockSize, numChannels, numLines, decimation));
+        buffers.emplace_back(numChannels, blockSize);
+    }
+
+    std::mt19937 rng(1234);
+
+    auto const numBlocks = std::max<uint64_t>(16, static_cast<uint64_t>(seconds * sampleRate / blockSize));
+    auto const numWarmupBlocks = std::max<uint64_t>(4, numBlocks / 20);
+
+    BenchmarkResult result;
+    result.numBlocks = numBlocks;
+    result.blockTimesUs.reserve(numBlocks);
+
+    double totalNs = 0;
+
+    for (uint64_t b = 0; b < numWarmupBlocks + numBlocks; ++b) {
+        for (auto& buffer : buffers)
+            fillInput(buffer, rng, sampleRate, b);
+
+        auto const measured = b >= numWarmupBlocks;
+
+        if (profile && b == numWarmupBlocks)
+            for (auto const& p : processors)
+                p->setProfilingEnabled(true);
+
+        processBlockAllocations.store(0);
+        isInsideProcessBlock = true;
+
+        auto const start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < processors.size(); ++i)
+            processors[i]->processBlock(buffers[i], midi);
+
+        auto const end = std::chrono::steady_clock::now();
+
+        isInsideProcessBlock = false;
+
+        if (measured) {
+            auto const ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+            totalNs += ns;
+            result.blockTimesUs.push_back(ns / 1000.0);
+            result.allocations += processBlockAllocations.load();
+
+            for (auto const& p : processors)
+                result.idleBlocks += p->isIdleBypassed() ? 1 : 0;
+        }
+    }
+
+    auto const totalSamples = static_cast<double>(numBlocks) * blockSize * numInstances;
+    auto const budgetNs = static_cast<double>(numBlocks) * blockSize / sampleRate * 1e9;
+
+    result.nsPerSample = totalNs / totalSamples;
+    result.realtimeLoad = totalNs / budgetNs;
+
+    // Entries of the same name, from different instances, add up
+    if (profile)
+        for (auto const& p : processors)
+            for (auto const& r : p->readProfile())
+                if (r.calls > 0)
+                    result.profileNsPerSample[r.name] += static_cast<double>(r.nanos) / totalSamples;
+
+    std::sort(result.blockTimesUs.begin(), result.blockTimesUs.end());
+    return result;
+}
+
+//==============================================================================
+// The fast path's output has to stay at least this far below the precise path's.
+// Its approximated modulators are within 2.1e-7 of std::sin, about as far as
+// std::sin's own rounding is from the exact sine, and that alone puts the two
+// outputs some 65 to 80dB apart. A slip in the approximation shows up well above this.
+static constexpr double kFastMathToleranceDb = -60.0;
+
+struct FastMathResult
+{
+    double preciseNsPerSample = 0;
+    double fastNsPerSample = 0;
+    double maxError = 0;
+    double errorDb = 0;
+};
+
+static FastMathResult runFastMathComparison(double sampleRate, int blockSize, int numChannels, int numLines, int decimation, double seconds)
+{
+    auto precise = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation, false);
+    auto fast = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation, true);
+
+    juce::AudioBuffer<float> input(numChannels, blockSize), preciseBuffer(numChannels, blockSize), fastBuffer(numChannels, blockSize);
+    juce::MidiBuffer midi;
+    std::mt19937 rng(1234);
+
+    auto const numBlocks = std::max<uint64_t>(16, static_cast<uint64_t>(seconds * sampleRate / blockSize));
+
+    double preciseNs = 0, fastNs = 0;
+    double signalSquares = 0, errorSquares = 0;
+    FastMathResult result;
+
+    auto const timeBlock = [&](EffectsPluginProcessor& p, juce::AudioBuffer<float>& buffer) {
+        buffer.makeCopyOf(input, true);
+
+        auto const start = std::chrono::steady_clock::now();
+        p.processBlock(buffer, midi);
+        auto const end = std::chrono::steady_clock::now();
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    };
+
+    for (uint64_t b = 0; b < numBlocks; ++b) {
+        fillInput(input, rng, sampleRate, b);
+
+        // Taking turns to go first evens out whatever the cache does for the second
+        if (b % 2 == 0) {
+            preciseNs += timeBlock(*precise, preciseBuffer);
+            fastNs += timeBlock(*fast, fastBuffer);
+        } else {
+            fastNs += timeBlock(*fast, fastBuffer);
+            preciseNs += timeBlock(*precise, preciseBuffer);
+        }
+
+        for (int ch = 0; ch < numChannels; ++ch) {
+            for (int j = 0; j < blockSize; ++j) {
+                auto const x = static_cast<double>(preciseBuffer.getSample(ch, j));
+                auto const e = static_cast<double>(fastBuffer.getSample(ch, j)) - x;
+
+                signalSquares += x * x;
+                errorSquares += e * e;
+                result.maxError = std::max(result.maxError, std::abs(e));
+            }
+        }
+    }
+
+    auto const totalSamples = static_cast<double>(numBlocks) * blockSize;
+
+    result.preciseNsPerSample = preciseNs / totalSamples;
+    result.fastNsPerSample = fastNs / totalSamples;
+    result.errorDb = (errorSquares > 0 && signalSquares > 0) ? 10.0 * std::log10(errorSquares / signalSquares) : -300.0;
+    return result;
+}
+
+//==============================================================================
+struct ParallelResult
+{
+    double serialNsPerSample = 0;
+    double parallelNsPerSample = 0;
+    bool pipelined = false;
+    bool identical = true;
+};
+
+static ParallelResult runParallelComparison(double sampleRate, int blockSize, int numChannels, int numLines, int decimation, double seconds)
+{
+    auto serial = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation, false, false);
+    auto parallel = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation, false, true);
+
+    // As an offline render, so that every block size goes through the pipeline
+    serial->setNonRealtime(true);
+    parallel->setNonRealtime(true);
+
+    juce::AudioBuffer<float> input(numChannels, blockSize), serialBuffer(numChannels, blockSize), parallelBuffer(numChannels, blockSize);
+    juce::MidiBuffer midi;
+    std::mt19937 rng(1234);
+
+    auto const numBlocks = std::max<uint64_t>(16, static_cast<uint64_t>(seconds * sampleRate / blockSize));
+
+    double serialNs = 0, parallelNs = 0;
+    ParallelResult result;
+    result.pipelined = parallel->isParallelProcessingEnabled();
+
+    auto const timeBlock = [&](EffectsPluginProcessor& p, juce::AudioBuffer<float>& buffer) {
+        buffer.makeCopyOf(input, true);
+
+        auto const start = std::chrono::steady_clock::now();
+        p.processBlock(buffer, midi);
+        auto const end = std::chrono::steady_clock::now();
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    };
+
+    for (uint64_t b = 0; b < numBlocks; ++b) {
+        fillInput(input, rng, sampleRate, b);
+
+        if (b % 2 == 0) {
+            serialNs += timeBlock(*serial, serialBuffer);
+            parallelNs += timeBlock(*parallel, parallelBuffer);
+        } else {
+            parallelNs += timeBlock(*parallel, parallelBuffer);
+            serialNs += timeBlock(*serial, serialBuffer);
+        }
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            result.identical = result.identical
+                && std::equal(serialBuffer.getReadPointer(ch), serialBuffer.getReadPointer(ch) + blockSize, parallelBuffer.getReadPointer(ch));
+    }
+
+    auto const totalSamples = static_cast<double>(numBlocks) * blockSize;
+
+    result.serialNsPerSample = serialNs / totalSamples;
+    result.parallelNsPerSample = parallelNs / totalSamples;
+    return result;
+}
+
+//==============================================================================
+struct WholeBlockResult
+{
+    double chunkedNsPerSample = 0;
+    double wholeBlockNsPerSample = 0;
+    uint64_t chunkedAllocations = 0;
+    uint64_t wholeBlockAllocations = 0;
+};
+
+static WholeBlockResult runWholeBlockComparison(double sampleRate, int blockSize, int numChannels, int numLines, int decimation, double seconds)
+{
+    auto chunked = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation);
+    auto wholeBlock = createProcessor(sampleRate, blockSize, numChannels, numLines, decimation, false, false, true);
+
+    juce::AudioBuffer<float> input(numChannels, blockSize), chunkedBuffer(numChannels, blockSize), wholeBlockBuffer(numChannels, blockSize);
+    juce::MidiBuffer midi;
+    std::mt19937 rng(1234);
+
+    auto const numBlocks = std::max<uint64_t>(16, static_cast<uint64_t>(seconds * sampleRate / blockSize));
+
+    double chunkedNs = 0, wholeBlockNs = 0;
+    WholeBlockResult result;
+
+    auto const timeBlock = [&](EffectsPluginProcessor& p, juce::AudioBuffer<float>& buffer, uint64_t& allocations) {
+        buffer.makeCopyOf(input, true);
+
+        processBlockAllocations.store(0);
+        isInsideProcessBlock = true;
+
+        auto const start = std::chrono::steady_clock::now();
+        p.processBlock(buffer, midi);
+        auto const end = std::chrono::steady_clock::now();
+
+        isInsideProcessBlock = false;
+        allocations += processBlockAllocations.load();
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    };
+
+    for (uint64_t b = 0; b < numBlocks; ++b) {
+        fillInput(input, rng, sampleRate, b);
+
+        if (b % 2 == 0) {
+            chunkedNs += timeBlock(*chunked, chunkedBuffer, result.chunkedAllocations);
+            wholeBlockNs += timeBlock(*wholeBlock, wholeBlockBuffer, result.wholeBlockAllocations);
+        } else {
+            wholeBlockNs += timeBlock(*wholeBlock, wholeBlockBuffer, result.wholeBlockAllocations);
+            chunkedNs += timeBlock(*chunked, chunkedBuffer, result.chunkedAllocations);
+        }
+    }
+
+    auto const totalSamples = static_cast<double>(numBlocks) * blockSize;
+
+    result.chunkedNsPerSample = chunkedNs / totalSamples;
+    result.wholeBlockNsPerSample = wholeBlockNs / totalSamples;
+    return result;
+}
+
+//==============================================================================
+struct TransportResult
+{
+    std::vector<double> renderToApplyMs;
+    size_t batchBytes = 0;
+};
+
+static TransportResult runTransport(EffectsPluginProcessor::InstructionTransport transport, int numRenders)
+{
+    EffectsPluginProcessor p;
+    p.setInstructionTransport(transport);
+    p.setPlayConfigDetails(2, 2, 48000, 512);
+    p.prepareToPlay(48000, 512);
+
+    TransportResult result;
+
+    // Every runtime reset builds a fresh runtime, which the engine then renders the whole graph
+    // into from scratch. The first render also loads the engine, so we leave it out.
+    for (int i = 0; i <= numRenders; ++i) {
+        p.resetRuntime();
+        p.handleAsyncUpdate();
+
+        auto const timings = p.getLastRenderTimings();
+
+        if (i > 0) {
+            result.renderToApplyMs.push_back(timings.renderToApplyMs);
+            result.batchBytes = timings.batchBytes;
+        }
+    }
+
+    std::sort(result.renderToApplyMs.begin(), result.renderToApplyMs.end());
+    return result;
+}
+
+//==============================================================================
+// Builds s = (x + 2) * x, used twice, as in y = s + s * 3. The shared tree and its
+// consumer each fuse into a kernel of their own, and the consumer's kernel reads the
+// shared one. We try the batch with either tree created first, since the order the
+// pass comes across them in shouldn't matter.
+static bool checkFusion()
+{
+    using elem::js::Number;
+    using elem::js::String;
+
+    auto const create = [](int id, char const* type) { return elem::js::Array { Number(0), Number(id), String(type) }; };
+    auto const append = [](int parent, int child) { return elem::js::Array { Number(2), Number(parent), Number(child), Number(0) }; };
+    auto const setValue = [](int id, char const* key, elem::js::Value value) { return elem::js::Array { Number(3), Number(id), String(key), value }; };
+
+    elem::js::Array const consumer { create(20, "add"), create(21, "mul") };
+    elem::js::Array const shared { create(10, "mul"), create(11, "add") };
+
+    elem::js::Array const rest {
+        create(1, "const"), setValue(1, "value", Number(2)),
+        create(2, "const"), setValue(2, "value", Number(3)),
+        create(3, "in"), setValue(3, "channel", Number(0)),
+        append(11, 3), append(11, 1),
+        append(10, 11), append(10, 3),
+        append(21, 10), append(21, 2),
+        append(20, 10), append(20, 21),
+        elem::js::Array { Number(4), elem::js::Array { Number(20) } },
+        elem::js::Array { Number(5) },
+    };
+
+    for (auto const consumerFirst : { true, false }) {
+        elem::js::Array batch(consumerFirst ? consumer : shared);
+        auto const& second = consumerFirst ? shared : consumer;
+
+        batch.insert(batch.end(), second.begin(), second.end());
+        batch.insert(batch.end(), rest.begin(), rest.end());
+
+        GraphFusion fusion;
+        auto const rewritten = fusion.process(batch);
+
+        if (fusion.getNumFusedKernels() != 2) {
+            std::cerr << "Expected the shared tree and its consumer to fuse separately, got "
+                      << fusion.getNumFusedKernels() << " kernels" << std::endl;
+            return false;
+        }
+
+        std::set<int> createdIds;
+
+        for (auto const& v : rewritten) {
+            auto const& ins = v.getArray();
+            auto const type = static_cast<int>(ins[0].getNumber());
+
+            if (type == 0)
+                createdIds.insert(static_cast<int>(ins[1].getNumber()));
+
+            if (type == 2) {
+                for (size_t i = 1; i <= 2; ++i) {
+                    if (createdIds.count(static_cast<int>(ins[i].getNumber())) == 0) {
+                        std::cerr << "The fused batch wires up node " << static_cast<int>(ins[i].getNumber()) << " before creating it" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+// Saves a session from an instance with every parameter away from its default, and
+// restores it into a fresh one. Those parameters only ever reach the network through
+// `param` nodes, so for the restored instance to sound exactly like the one that saved
+// it, and not like a fresh one, its `param` nodes have to be putting out the restored
+// values.
+static bool checkState()
+{
+    std::map<juce::String, float> const values { { "size", 0.9f }, { "decay", 0.2f }, { "mod", 0.8f }, { "mix", 0.3f } };
+
+    auto const prepare = [](EffectsPluginProcessor& p) {
+        p.setPlayConfigDetails(2, 2, 48000, 512);
+        p.prepareToPlay(48000, 512);
+    };
+
+    EffectsPluginProcessor saved, restored, fresh;
+    juce::MemoryBlock session;
+
+    prepare(saved);
+
+    for (auto const& [paramId, value] : values)
+        setParameter(saved, paramId, value);
+
+    saved.handleAsyncUpdate();
+    saved.getStateInformation(session);
+
+    prepare(restored);
+    restored.setStateInformation(session.getData(), static_cast<int>(session.getSize()));
+    prepare(fresh);
+
+    for (auto* p : { &saved, &restored, &fresh }) {
+        p->handleAsyncUpdate();
+        p->waitForEngine();
+    }
+
+    for (auto* param : restored.getParameters()) {
+        if (auto* pf = dynamic_cast<juce::AudioParameterFloat*>(param)) {
+            auto it = values.find(pf->paramID);
+
+            if (it != values.end() && std::abs(pf->get() - it->second) > 1.0e-6f) {
+                std::cerr << "Restored " << pf->paramID << " as " << pf->get() << ", expected " << it->second << std::endl;
+                return false;
+            }
+        }
+    }
+
+    juce::AudioBuffer<float> input(2, 512), savedBuffer(2, 512), restoredBuffer(2, 512), freshBuffer(2, 512);
+    juce::MidiBuffer midi;
+    std::mt19937 rng(1234);
+
+    auto matchesSaved = true;
+    auto matchesFresh = true;
+
+    for (uint64_t b = 0; b < 64; ++b) {
+        fillInput(input, rng, 48000, b);
+
+        for (auto [p, buffer] : { std::make_pair(&saved, &savedBuffer), std::make_pair(&restored, &restoredBuffer), std::make_pair(&fresh, &freshBuffer) }) {
+            buffer->makeCopyOf(input, true);
+            p->processBlock(*buffer, midi);
+        }
+
+        for (int ch = 0; ch < 2; ++ch) {
+            matchesSaved = matchesSaved
+                && std::equal(savedBuffer.getReadPointer(ch), savedBuffer.getReadPointer(ch) + 512, restoredBuffer.getReadPointer(ch));
+            matchesFresh = matchesFresh
+                && std::equal(freshBuffer.getReadPointer(ch), freshBuffer.getReadPointer(ch) + 512, restoredBuffer.getReadPointer(ch));
+        }
+    }
+
+    if (!matchesSaved || matchesFresh) {
+        std::cerr << "The restored instance doesn't play at the values it was saved with" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+// The process's resident memory in bytes, where we know how to ask for it
+static int64_t getResidentBytes()
+{
+#if JUCE_LINUX
+    long pages = 0, residentPages = 0;
+
+    if (auto* f = std::fopen("/proc/self/statm", "r")) {
+        auto const numRead = std::fscanf(f, "%ld %ld", &pages, &residentPages);
+        std::fclose(f);
+
+        if (numRead == 2)
+            return static_cast<int64_t>(residentPages) * juce::SystemStats::getPageSize();
+    }
+
+    return 0;
+#elif JUCE_MAC
+    mach_task_basic_info info {};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+        return static_cast<int64_t>(info.resident_size);
+
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+struct InstantiationResult
+{
+    double totalMs = 0;
+    double firstMs = 0;
+    int64_t residentBytes = 0;
+};
+
+static InstantiationResult runInstantiation(int numInstances)
+{
+    std::vector<std::unique_ptr<EffectsPluginProcessor>> processors;
+    InstantiationResult result;
+
+    auto const residentBefore = getResidentBytes();
+    auto const start = std::chrono::steady_clock::now();
+
+    // Like a host restoring a session, we bring every instance up before waiting on
+    // any of them, and only then wait for their engines to render
+    for (int i = 0; i < numInstances; ++i) {
+        auto p = std::make_unique<EffectsPluginProcessor>();
+
+        p->setPlayConfigDetails(2, 2, 48000, 512);
+        p->prepareToPlay(48000, 512);
+        p->handleAsyncUpdate();
+
+        if (i == 0) {
+            p->waitForEngine();
+            result.firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        processors.push_back(std::move(p));
+    }
+
+    for (auto const& p : processors)
+        p->waitForEngine();
+
+    result.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.residentBytes = getResidentBytes() - residentBefore;
+    return result;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--check-fusion"))
+        return checkFusion() ? 0 : 1;
+
+    auto const assetsDir = args.containsOption("--assets")
+        ? juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--assets"))
+        : juce::File(ELEM_TOOLS_ASSETS_DIR);
+
+    if (!assetsDir.getChildFile("manifest.json").existsAsFile() || !assetsDir.getChildFile("dsp.main.js").existsAsFile()) {
+        std::cerr << "Could not find manifest.json and dsp.main.js in " << assetsDir.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    setAssetsDirectory(assetsDir);
+
+    if (args.containsOption("--check-state"))
+        return checkState() ? 0 : 1;
+
+    auto const rates = parseList(args, "--rates", { 44100, 48000, 88200, 96000, 176400, 192000 });
+    auto const blocks = parseList(args, "--blocks", { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 });
+    auto const instances = parseList(args, "--instances", { 1, 8, 32 });
+    auto const channelCounts = parseList(args, "--channels", { 2 });
+    auto const lineCounts = parseList(args, "--lines", { 8 });
+    auto const decimations = parseList(args, "--decimation", { 1 });
+    auto const seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 2.0;
+    auto const profile = args.containsOption("--profile");
+    auto const label = args.getValueForOption("--label").toStdString();
+
+    std::unique_ptr<juce::FileOutputStream> fileOutput;
+
+    if (args.containsOption("--output")) {
+        auto f = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--output"));
+        f.deleteFile();
+        fileOutput = f.createOutputStream();
+    }
+
+    auto const writeLine = [&](std::string const& line) {
+        if (fileOutput != nullptr)
+            *fileOutput << juce::String(line) << "\n";
+        else
+            std::cout << line << std::endl;
+    };
+
+    if (args.containsOption("--transport")) {
+        auto const numRenders = args.containsOption("--renders") ? juce::jmax(1, args.getValueForOption("--renders").getIntValue()) : 50;
+
+        for (auto const& [name, transport] : { std::make_pair("json", EffectsPluginProcessor::InstructionTransport::Json),
+                                                std::make_pair("binary", EffectsPluginProcessor::InstructionTransport::Binary) }) {
+            auto r = runTransport(transport, numRenders);
+
+            writeLine(choc::json::toString(choc::value::createObject("",
+                "label", label,
+                "transport", name,
+                "renders", numRenders,
+                "batchBytes", static_cast<int64_t>(r.batchBytes),
+                "renderToApplyMs", choc::value::createObject("",
+                    "p50", percentile(r.renderToApplyMs, 0.5),
+                    "p90", percentile(r.renderToApplyMs, 0.9),
+                    "max", r.renderToApplyMs.empty() ? 0.0 : r.renderToApplyMs.back()))));
+        }
+
+        return 0;
+    }
+
+    if (args.containsOption("--fast-math")) {
+        auto withinTolerance = true;
+
+        for (auto const rate : rates) {
+            for (auto const block : blocks) {
+                for (auto const numChannels : channelCounts) {
+                    for (auto const numLines : lineCounts) {
+                        for (auto const decimation : decimations) {
+                            auto r = runFastMathComparison(static_cast<double>(rate), block, numChannels, numLines, decimation, seconds);
+                            withinTolerance = withinTolerance && r.errorDb <= kFastMathToleranceDb;
+
+                            writeLine(choc::json::toString(choc::value::createObject("",
+                                "label", label,
+                                "sampleRate", rate,
+                                "blockSize", block,
+                                "channels", numChannels,
+                                "lines", numLines,
+                                "decimation", decimation,
+                                "preciseNsPerSample", r.preciseNsPerSample,
+                                "fastNsPerSample", r.fastNsPerSample,
+                                "speedup", r.fastNsPerSample > 0 ? r.preciseNsPerSample / r.fastNsPerSample : 0.0,
+                                "maxError", r.maxError,
+                                "errorDb", r.errorDb)));
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!withinTolerance)
+            std::cerr << "The fast math path strayed further than " << kFastMathToleranceDb << "dB from the precise path" << std::endl;
+
+        return withinTolerance ? 0 : 1;
+    }
+
+    if (args.containsOption("--parallel")) {
+        auto identical = true;
+
+        for (auto const rate : rates) {
+            for (auto const block : blocks) {
+                for (auto const numChannels : channelCounts) {
+                    for (auto const numLines : lineCounts) {
+                        for (auto const decimation : decimations) {
+                            auto r = runParallelComparison(static_cast<double>(rate), block, numChannels, numLines, decimation, seconds);
+                            identical = identical && r.identical;
+
+                            writeLine(choc::json::toString(choc::value::createObject("",
+                                "label", label,
+                                "sampleRate", rate,
+                                "blockSize", block,
+                                "channels", numChannels,
+                                "lines", numLines,
+                                "decimation", decimation,
+                                "pipelined", r.pipelined,
+                                "serialNsPerSample", r.serialNsPerSample,
+                                "parallelNsPerSample", r.parallelNsPerSample,
+                                "speedup", r.parallelNsPerSample > 0 ? r.serialNsPerSample / r.parallelNsPerSample : 0.0,
+                                "identical", r.identical)));
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!identical)
+            std::cerr << "The parallel path's output differed from the serial path's" << std::endl;
+
+        return identical ? 0 : 1;
+    }
+
+    if (args.containsOption("--whole-block")) {
+        for (auto const rate : rates) {
+            for (auto const block : blocks) {
+                for (auto const numChannels : channelCounts) {
+                    for (auto const numLines : lineCounts) {
+                        for (auto const decimation : decimations) {
+                            auto r = runWholeBlockComparison(static_cast<double>(rate), block, numChannels, numLines, decimation, seconds);
+
+                            writeLine(choc::json::toString(choc::value::createObject("",
+                                "label", label,
+                                "sampleRate", rate,
+                                "blockSize", block,
+                                "channels", numChannels,
+                                "lines", numLines,
+                                "decimation", decimation,
+                                "chunkedNsPerSample", r.chunkedNsPerSample,
+                                "wholeBlockNsPerSample", r.wholeBlockNsPerSample,
+                                "speedup", r.chunkedNsPerSample > 0 ? r.wholeBlockNsPerSample / r.chunkedNsPerSample : 0.0,
+                                "chunkedAllocations", static_cast<int64_t>(r.chunkedAllocations),
+                                "wholeBlockAllocations", static_cast<int64_t>(r.wholeBlockAllocations))));
+                        }
+                    }
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    if (args.containsOption("--instantiation")) {
+        // Loading the engine the first time fills the process-wide caches, which we
+        // leave out, so that each count sees the same warm process
+        runInstantiation(1);
+
+        for (auto const n : parseList(args, "--instantiation", { 1, 16, 64, 256 })) {
+            auto r = runInstantiation(n);
+
+            writeLine(choc::json::toString(choc::value::createObject("",
+                "label", label,
+                "instances", n,
+                "totalMs", r.totalMs,
+                "msPerInstance", r.totalMs / n,
+                "firstInstanceMs", r.firstMs,
+                "residentBytesPerInstance", r.residentBytes / n)));
+        }
+
+        return 0;
+    }
+
+    for (auto const rate : rates) {
+        for (auto const block : blocks) {
+            for (auto const n : instances) {
+                for (auto const numChannels : channelCounts) {
+                    for (auto const numLines : lineCounts) {
+                        for (auto const decimation : decimations) {
+                            auto r = runConfiguration(static_cast<double>(rate), block, n, numChannels, numLines, decimation, seconds, profile);
+
+                            auto line = choc::value::createObject("",
+                                "label", label,
+                                "sampleRate", rate,
+                                "blockSize", block,
+                                "instances", n,
+                                "channels", numChannels,
+                                "lines", numLines,
+                                "decimation", decimation,
+                                "blocks", static_cast<int64_t>(r.numBlocks),
+                                "nsPerSample", r.nsPerSample,
+                                "nsPerChannelSample", r.nsPerSample / numChannels,
+                                "realtimeLoad", r.realtimeLoad,
+                                "blockTimeUs", choc::value::createObject("",
+                                    "p50", percentile(r.blockTimesUs, 0.5),
+                                    "p90", percentile(r.blockTimesUs, 0.9),
+                                    "p99", percentile(r.blockTimesUs, 0.99),
+                                    "max", r.blockTimesUs.empty() ? 0.0 : r.blockTimesUs.back()),
+                                "allocations", static_cast<int64_t>(r.allocations),
+                                "idleFraction", static_cast<double>(r.idleBlocks) / static_cast<double>(r.numBlocks * static_cast<uint64_t>(n)));
+
+                            if (profile) {
+                                auto breakdown = choc::value::createObject("");
+
+                                for (auto const& [name, ns] : r.profileNsPerSample)
+                                    breakdown.addMember(name, ns);
+
+                                line.addMember("profileNsPerSample", breakdown);
+                            }
+
+                            writeLine(choc::json::toString(line));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "BytecodeCache.h"
+
+#include <map>
+#include <mutex>
+
+
+namespace
+{
+    // Files start with this, then the engine version, the source hash, the bytecode's
+    // own hash and its size, then the bytecode itself
+    constexpr int kFileMagic = 0x32514253; // "SBQ2"
+
+    // 64-bit FNV-1a
+    uint64_t hashBytes(void const* data, size_t size)
+    {
+        auto const* bytes = static_cast<uint8_t const*>(data);
+        uint64_t hash = 0xcbf29ce484222325ull;
+
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    //==============================================================================
+    // Bytecode we've already read or written in this process, by script name
+    struct CachedBytecode {
+        uint64_t sourceHash = 0;
+        std::string engineVersion;
+        std::shared_ptr<BytecodeCache::Bytecode const> bytecode;
+    };
+
+    std::mutex memoryCacheLock;
+
+    std::map<std::string, CachedBytecode>& getMemoryCache()
+    {
+        static std::map<std::string, CachedBytecode> cache;
+        return cache;
+    }
+
+    //==============================================================================
+    // Reads a file's bytecode if it's for the given source and engine. A file that is,
+    // but whose bytecode doesn't add up, is flagged as corrupt.
+    bool readCacheFile(juce::File const& file, uint64_t sourceHash, std::string const& engineVersion, std::vector<uint8_t>& bytecode, bool& isCorrupt)
+    {
+        juce::FileInputStream in(file);
+
+        if (!in.openedOk() || in.readInt() != kFileMagic || in.readString().toStdString() != engineVersion)
+            return false;
+
+        if (static_cast<uint64_t>(in.readInt64()) != sourceHash)
+            return false;
+
+        auto const bytecodeHash = static_cast<uint64_t>(in.readInt64());
+        auto const size = in.readInt64();
+
+        isCorrupt = size <= 0 || size != in.getNumBytesRemaining();
+
+        if (isCorrupt)
+            return false;
+
+        bytecode.resize(static_cast<size_t>(size));
+
+        isCorrupt = in.read(bytecode.data(), static_cast<int>(size)) != static_cast<int>(size)
+                 || hashBytes(bytecode.data(), bytecode.size()) != bytecodeHash;
+
+        return !isCorrupt;
+    }
+
+    void writeCacheFile(juce::File const& file, uint64_t sourceHash, std::string const& engineVersion, std::vector<uint8_t> const& bytecode)
+    {
+        // Several processes, or several render threads, may well be writing the same
+        // file at once, so we write aside and move into place
+        if (!file.getParentDirectory().createDirectory())
+            return;
+
+        juce::TemporaryFile temp(file);
+
+        if (auto out = temp.getFile().createOutputStream()) {
+            out->writeInt(kFileMagic);
+            out->writeString(engineVersion);
+            out->writeInt64(static_cast<juce::int64>(sourceHash));
+            out->writeInt64(static_cast<juce::int64>(hashBytes(bytecode.data(), bytecode.size())));
+            out->writeInt64(static_cast<juce::int64>(bytecode.size()));
+            out->write(bytecode.data(), bytecode.size());
+            out->flush();
+
+            if (out->getStatus().failed())
+                return;
+        }
+
+        temp.overwriteTargetFileWithTemporary();
+    }
+}
+
+//==============================================================================
+BytecodeCache::BytecodeCache (juce::File dir)
+    : directory(std::move(dir))
+{
+}
+
+juce::File BytecodeCache::getDefaultDirectory()
+{
+#if JUCE_MAC
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("Caches/audio.elementary.srvb");
+#else
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("Elementary Audio/SRVB/Cache");
+#endif
+}
+
+uint64_t BytecodeCache::hashSource (std::string const& source)
+{
+    return hashBytes(source.data(), source.size());
+}
+
+//==============================================================================
+std::shared_ptr<BytecodeCache::Bytecode const> BytecodeCache::load (std::string const& name, uint64_t sourceHash, std::string const& engineVersion)
+{
+    {
+        std::lock_guard<std::mutex> lock(memoryCacheLock);
+        auto it = getMemoryCache().find(name);
+
+        if (it != getMemoryCache().end() && it->second.sourceHash == sourceHash && it->second.engineVersion == engineVersion)
+            return it->second.bytecode;
+    }
+
+    auto const file = getCacheFile(name);
+    auto bytecode = std::make_shared<Bytecode>();
+    auto isCorrupt = false;
+
+    if (!readCacheFile(file, sourceHash, engineVersion, *bytecode, isCorrupt)) {
+        // QuickJS doesn't check bytecode as it loads it, so bytecode that was cut short
+        // or damaged on disk never gets that far. We delete it, and the caller compiles
+        // and stores afresh.
+        if (isCorrupt)
+            file.deleteFile();
+
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(memoryCacheLock);
+    getMemoryCache()[name] = { sourceHash, engineVersion, bytecode };
+    return bytecode;
+}
+
+void BytecodeCache::store (std::string const& name, uint64_t sourceHash, std::string const& engineVersion, Bytecode bytecode)
+{
+    writeCacheFile(getCacheFile(name), sourceHash, engineVersion, bytecode);
+
+    std::lock_guard<std::mutex> lock(memoryCacheLock);
+    getMemoryCache()[name] = { sourceHash, engineVersion, std::make_shared<Bytecode const>(std::move(bytecode)) };
+}
+
+void BytecodeCache::invalidate (std::string const& name)
+{
+    std::lock_guard<std::mutex> lock(memoryCacheLock);
+    getMemoryCache().erase(name);
+}
+
+juce::File BytecodeCache::getCacheFile (std::string const& name) const
+{
+    return directory.getChildFile(juce::File::createLegalFileName(name) + ".qjsc");
+}
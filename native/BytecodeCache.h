@@ -0,0 +1,58 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//==============================================================================
+// Stores compiled QuickJS bytecode for the DSP bundle, so that instantiating an
+// engine doesn't mean parsing and compiling the same script every time.
+//
+// Entries are keyed by script name and tagged with a hash of the source and the
+// engine version that compiled them; a lookup only succeeds if both still match.
+// Each file also carries a hash of its bytecode, which has to match what we read
+// back before any of it reaches QuickJS, and a file whose bytecode doesn't is deleted.
+// Entries live in the cache directory, where they survive across processes, and in
+// memory, so a session full of instances only reads each one from disk once, and
+// shares the one copy of it from then on.
+//
+// See EngineContext::evaluate, which compiles and loads the bytecode.
+class BytecodeCache
+{
+public:
+    //==============================================================================
+    /** Creates a cache which reads and writes files in the given directory. */
+    explicit BytecodeCache (juce::File directory = getDefaultDirectory());
+
+    /** The per-user location we cache into unless told otherwise. */
+    static juce::File getDefaultDirectory();
+
+    /** A hash of a script's source, for tagging its bytecode. */
+    static uint64_t hashSource (std::string const& source);
+
+    //==============================================================================
+    using Bytecode = std::vector<uint8_t>;
+
+    /** Fetches the bytecode for a script if we have any that matches the given source
+        hash and engine version, or returns nullptr. Safe from any thread.
+    */
+    std::shared_ptr<Bytecode const> load (std::string const& name, uint64_t sourceHash, std::string const& engineVersion);
+
+    /** Stores freshly compiled bytecode for a script, replacing any previous entry. Safe from any thread. */
+    void store (std::string const& name, uint64_t sourceHash, std::string const& engineVersion, Bytecode bytecode);
+
+    /** Drops a script's entry from memory, e.g. after the engine refused to load it. */
+    void invalidate (std::string const& name);
+
+private:
+    //==============================================================================
+    juce::File getCacheFile (std::string const& name) const;
+
+    juce::File directory;
+
+    JUCE_DECLARE_NON_COPYABLE (BytecodeCache)
+};
@@ -0,0 +1,144 @@
+#include "EngineContext.h"
+
+#include <choc_javascript_QuickJS.h>
+
+
+namespace
+{
+    namespace qjs = choc::javascript::quickjs;
+
+    // Bytecode is only valid for the QuickJS that wrote it, so we tag cached bytecode
+    // with a hash of the QuickJS source we're built from, and the plugin version that
+    // shipped it. A rebuild of the same sources keeps the cache.
+    constexpr auto kEngineVersion = "quickjs " ELEM_QUICKJS_SOURCE_HASH " srvb " ELEM_PLUGIN_VERSION;
+
+    [[noreturn]] void throwPendingException(qjs::JSContext* ctx)
+    {
+        auto exception = qjs::JS_GetException(ctx);
+        std::string message = "Unknown error";
+
+        if (auto const* str = qjs::JS_ToCString(ctx, exception)) {
+            message = str;
+            qjs::JS_FreeCString(ctx, str);
+        }
+
+        qjs::JS_FreeValue(ctx, exception);
+        throw choc::javascript::Error(message);
+    }
+
+    void runCompiledScript(qjs::JSContext* ctx, qjs::JSValue function)
+    {
+        // Takes ownership of the function
+        auto result = qjs::JS_EvalFunction(ctx, function);
+
+        if (qjs::JS_IsException(result))
+            throwPendingException(ctx);
+
+        qjs::JS_FreeValue(ctx, result);
+    }
+
+    //==============================================================================
+    // The trampoline behind registerBinaryFunction. The callback's address rides along
+    // as the function's data, which QuickJS holds as a number; user-space addresses
+    // fit well within the 53 bits that represents exactly.
+    qjs::JSValue callBinaryFunction(qjs::JSContext* ctx, qjs::JSValueConst, int argc, qjs::JSValueConst* argv, int, qjs::JSValue* data)
+    {
+        int64_t address = 0;
+
+        if (qjs::JS_ToInt64(ctx, &address, data[0]) != 0)
+            return qjs::JS_EXCEPTION;
+
+        auto* fn = reinterpret_cast<EngineContext::BinaryFunction*>(static_cast<uintptr_t>(address));
+
+        size_t size = 0;
+        auto* bytes = (argc > 0) ? qjs::JS_GetArrayBuffer(ctx, &size, argv[0]) : nullptr;
+
+        // JS_GetArrayBuffer has already thrown if we were given anything else
+        if (bytes == nullptr)
+            return (argc > 0) ? qjs::JS_EXCEPTION : qjs::JS_ThrowTypeError(ctx, "Expected an ArrayBuffer");
+
+        // C++ exceptions mustn't unwind through QuickJS, so they come back as JavaScript ones
+        std::string result;
+
+        try {
+            result = choc::json::toString((*fn)(bytes, size));
+        } catch (std::exception const& e) {
+            return qjs::JS_ThrowInternalError(ctx, "%s", e.what());
+        }
+
+        if (result.empty() || result == "null")
+            return qjs::JS_UNDEFINED;
+
+        return qjs::JS_ParseJSON(ctx, result.c_str(), result.size(), "<native>");
+    }
+}
+
+//==============================================================================
+void EngineContext::create()
+{
+    auto impl = std::make_unique<qjs::QuickJSContext>();
+    rawContext = impl->context;
+
+    // The old context has to go before the callbacks it may still refer to
+    context = choc::javascript::Context(std::move(impl));
+    binaryFunctions.clear();
+}
+
+void EngineContext::evaluate (std::string const& source, std::string const& name, BytecodeCache& cache)
+{
+    auto* ctx = static_cast<qjs::JSContext*>(rawContext);
+
+    if (ctx == nullptr)
+        return (void) context.evaluate(source);
+
+    auto const sourceHash = BytecodeCache::hashSource(source);
+
+    // Bytecode is shared by every engine in the process, and QuickJS only reads it
+    if (auto const bytecode = cache.load(name, sourceHash, kEngineVersion)) {
+        auto function = qjs::JS_ReadObject(ctx, bytecode->data(), bytecode->size(), JS_READ_OBJ_BYTECODE);
+
+        if (!qjs::JS_IsException(function))
+            return runCompiledScript(ctx, function);
+
+        // The bytecode passed our checks but QuickJS won't take it, so we drop it and
+        // compile afresh below
+        qjs::JS_FreeValue(ctx, qjs::JS_GetException(ctx));
+        cache.invalidate(name);
+    }
+
+    // No usable bytecode, so we compile from source and cache the result
+    auto function = qjs::JS_Eval(ctx, source.c_str(), source.size(), name.c_str(), JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+
+    if (qjs::JS_IsException(function)) {
+        // Leave it to choc to report whatever's wrong with the source
+        qjs::JS_FreeValue(ctx, qjs::JS_GetException(ctx));
+        return (void) context.evaluate(source);
+    }
+
+    size_t size = 0;
+
+    if (auto* buffer = qjs::JS_WriteObject(ctx, &size, function, JS_WRITE_OBJ_BYTECODE)) {
+        cache.store(name, sourceHash, kEngineVersion, BytecodeCache::Bytecode(buffer, buffer + size));
+        qjs::js_free(ctx, buffer);
+    }
+
+    runCompiledScript(ctx, function);
+}
+
+void EngineContext::registerBinaryFunction (std::string const& name, BinaryFunction fn)
+{
+    auto* ctx = static_cast<qjs::JSContext*>(rawContext);
+
+    if (ctx == nullptr)
+        return;
+
+    binaryFunctions.push_back(std::make_unique<BinaryFunction>(std::move(fn)));
+
+    auto address = qjs::JS_NewInt64(ctx, static_cast<int64_t>(reinterpret_cast<uintptr_t>(binaryFunctions.back().get())));
+    auto function = qjs::JS_NewCFunctionData(ctx, callBinaryFunction, 1, 0, 1, &address);
+    auto global = qjs::JS_GetGlobalObject(ctx);
+
+    qjs::JS_SetPropertyStr(ctx, global, name.c_str(), function);
+    qjs::JS_FreeValue(ctx, global);
+    qjs::JS_FreeValue(ctx, address);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <choc_javascript.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BytecodeCache.h"
+
+
+//==============================================================================
+// The embedded engine's JavaScript context: a choc QuickJS context, plus the few
+// things we need from QuickJS itself that choc doesn't expose, namely bytecode
+// and zero-copy ArrayBuffer arguments.
+//
+// QuickJS binds each context to the stack of the thread that creates it, so a
+// context must only be created and used on one thread.
+class EngineContext
+{
+public:
+    //==============================================================================
+    /** Replaces the current context, and everything registered with it, with a fresh one. */
+    void create();
+
+    //==============================================================================
+    /** The choc::javascript::Context interface we use, forwarded as is. */
+    choc::value::Value evaluate (std::string const& code)
+    {
+        return context.evaluate(code);
+    }
+
+    template <typename... Args>
+    choc::value::Value invoke (std::string_view functionName, Args&&... args)
+    {
+        return context.invoke(functionName, std::forward<Args>(args)...);
+    }
+
+    template <typename Fn>
+    void registerFunction (std::string const& name, Fn&& fn)
+    {
+        context.registerFunction(name, std::forward<Fn>(fn));
+    }
+
+    //==============================================================================
+    /** Evaluates a script, loading cached bytecode where it's valid and compiling from
+        source otherwise, and updating the cache as needed. `name` identifies the script
+        across loads. Errors thrown by the script surface as choc::javascript::Error,
+        the same as from evaluate().
+    */
+    void evaluate (std::string const& source, std::string const& name, BytecodeCache& cache);
+
+    /** Registers a global function which takes a single ArrayBuffer and hands its bytes
+        to the callback in place, without copying or converting them. The callback's
+        result goes back to JavaScript by way of JSON, so should be small.
+    */
+    using BinaryFunction = std::function<choc::value::Value(uint8_t const* data, size_t size)>;
+    void registerBinaryFunction (std::string const& name, BinaryFunction fn);
+
+private:
+    //==============================================================================
+    choc::javascript::Context context;
+
+    // The QuickJS context behind `context`, kept opaque here so that only
+    // EngineContext.cpp sees the QuickJS implementation
+    void* rawContext = nullptr;
+
+    std::vector<std::unique_ptr<BinaryFunction>> binaryFunctions;
+};
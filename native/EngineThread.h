@@ -0,0 +1,206 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+
+//==============================================================================
+// A queue of jobs which run one at a time, in the order they were posted, on a
+// worker thread shared with other processors.
+//
+// Each processor owns one and keeps its embedded JavaScript engine on it, so that
+// rendering the graph never holds up the host's message thread. Posting is cheap
+// and never waits on a job that's running.
+//
+// The worker threads themselves are shared across the process: the first few
+// processors each get one of their own, and after that each new processor shares
+// whichever has the fewest. A processor's jobs always run on the same worker, so
+// its engine stays on the one thread as QuickJS requires, and a session of hundreds
+// of instances runs on a handful of threads rather than one apiece. Workers go
+// when the last processor using them does.
+class EngineThread
+{
+public:
+    //==============================================================================
+    EngineThread()
+        : worker(Worker::acquire())
+    {
+    }
+
+    ~EngineThread()
+    {
+        stop();
+    }
+
+    //==============================================================================
+    /** Queues a job to run on the worker thread after everything posted before it. */
+    void post (std::function<void()> job)
+    {
+        if (!stopped.load())
+            worker->post(this, std::move(job));
+    }
+
+    /** Blocks until every job posted so far has run, or until the timeout expires.
+        Must not be called from the worker thread itself.
+    */
+    bool waitUntilIdle (int timeoutMs = -1)
+    {
+        jassert (! worker->isThisThread());
+
+        if (stopped.load())
+            return false;
+
+        auto done = std::make_shared<juce::WaitableEvent>();
+        post([done]() { done->signal(); });
+
+        return done->wait(timeoutMs);
+    }
+
+    /** Lets our job in progress, if there is one, finish, and drops the rest of our queue.
+        Anything posted afterwards is dropped too.
+    */
+    void stop()
+    {
+        stopped.store(true);
+        worker->cancel(this);
+    }
+
+private:
+    //==============================================================================
+    class Worker : private juce::Thread
+    {
+    public:
+        Worker()
+            : juce::Thread("SRVB Engine")
+        {
+            startThread();
+        }
+
+        ~Worker() override
+        {
+            signalThreadShouldExit();
+            jobAvailable.signal();
+            stopThread(-1);
+        }
+
+        // Hands out workers, starting new ones up to kMaxWorkers, then sharing the
+        // least busy
+        static std::shared_ptr<Worker> acquire()
+        {
+            static std::mutex workersLock;
+            static std::array<std::weak_ptr<Worker>, kMaxWorkers> workers;
+
+            std::lock_guard<std::mutex> lock(workersLock);
+            std::shared_ptr<Worker> leastUsed;
+
+            for (auto& slot : workers) {
+                auto w = slot.lock();
+
+                if (w == nullptr) {
+                    w = std::make_shared<Worker>();
+                    slot = w;
+                    return w;
+                }
+
+                if (leastUsed == nullptr || w.use_count() < leastUsed.use_count())
+                    leastUsed = std::move(w);
+            }
+
+            return leastUsed;
+        }
+
+        void post (EngineThread const* owner, std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queueLock);
+                queue.push_back({ owner, std::move(job) });
+            }
+
+            jobAvailable.signal();
+        }
+
+        // Drops the owner's queued jobs and waits out the one running, if it's theirs.
+        // That job may have queued more before it saw its owner stop, so we drop
+        // the owner's jobs once more after it's finished.
+        void cancel (EngineThread const* owner)
+        {
+            jassert (! isThisThread());
+
+            auto const isOwners = [owner](Job const& j) { return j.owner == owner; };
+            std::unique_lock<std::mutex> lock(queueLock);
+
+            queue.erase(std::remove_if(queue.begin(), queue.end(), isOwners), queue.end());
+            jobFinished.wait(lock, [&]() { return running != owner; });
+            queue.erase(std::remove_if(queue.begin(), queue.end(), isOwners), queue.end());
+        }
+
+        bool isThisThread() const
+        {
+            return getThreadId() == juce::Thread::getCurrentThreadId();
+        }
+
+    private:
+        // About as many threads as a session could keep busy rendering at once
+        static constexpr size_t kMaxWorkers = 8;
+
+        struct Job {
+            EngineThread const* owner = nullptr;
+            std::function<void()> run;
+        };
+
+        void run() override
+        {
+            while (!threadShouldExit()) {
+                Job job;
+
+                {
+                    std::lock_guard<std::mutex> lock(queueLock);
+
+                    if (!queue.empty()) {
+                        job = std::move(queue.front());
+                        queue.pop_front();
+                        running = job.owner;
+                    }
+                }
+
+                if (!job.run) {
+                    jobAvailable.wait(-1);
+                    continue;
+                }
+
+                job.run();
+
+                // The job goes before we say we're done with it, since whatever it
+                // captured may well belong to the owner that's waiting on us
+                job = {};
+
+                {
+                    std::lock_guard<std::mutex> lock(queueLock);
+                    running = nullptr;
+                }
+
+                jobFinished.notify_all();
+            }
+        }
+
+        std::mutex queueLock;
+        std::deque<Job> queue;
+        EngineThread const* running = nullptr;
+
+        juce::WaitableEvent jobAvailable;
+        std::condition_variable jobFinished;
+    };
+
+    std::shared_ptr<Worker> worker;
+    std::atomic<bool> stopped { false };
+
+    JUCE_DECLARE_NON_COPYABLE (EngineThread)
+};
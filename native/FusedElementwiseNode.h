@@ -0,0 +1,219 @@
+#pragma once
+
+#include <elem/GraphNode.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//==============================================================================
+// A single node evaluating a whole tree of elementwise arithmetic.
+//
+// GraphFusion compiles regions of `mul`/`add`/`sub`/`const`/`select` nodes into
+// a small register program which it hands to this node through the "program"
+// property. The program runs over the block in short chunks so that every
+// intermediate result stays in a chunk-sized register in cache rather than in
+// a full block-sized buffer per original node.
+//
+// Operands are addressed through a flat slot space: first the node's children
+// (inputs), then the program's constants, then its registers. Constants can be
+// updated afterwards through "const<slot>" properties, which is how ref updates
+// on the original const nodes reach the fused node.
+template <typename FloatType>
+struct FusedElementwiseNode : public elem::GraphNode<FloatType>
+{
+    enum Opcode { Copy = 0, Add = 1, Sub = 2, Mul = 3, Select = 4 };
+
+    static constexpr size_t kChunkSize = 64;
+
+    FusedElementwiseNode(elem::NodeId id, double sampleRate, int const blockSize)
+        : elem::GraphNode<FloatType>::GraphNode(id, sampleRate, blockSize)
+    {
+        zeros.assign(kChunkSize, FloatType(0));
+    }
+
+    int setProperty(std::string const& key, elem::js::Value const& val) override
+    {
+        if (key == "program") {
+            // The program is fixed for the lifetime of the node; GraphFusion
+            // creates a new node whenever a region changes shape
+            if (ready.load())
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            if (!val.isObject())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            if (!loadProgram(val.getObject()))
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            ready.store(true);
+        }
+
+        if (key.rfind("const", 0) == 0 && key.size() > 5) {
+            if (!val.isNumber())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            auto const slot = static_cast<size_t>(std::stoul(key.substr(5)));
+
+            if (slot >= numConsts)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            consts[slot].store(static_cast<FloatType>(val.getNumber()));
+        }
+
+        return elem::GraphNode<FloatType>::setProperty(key, val);
+    }
+
+    void process (elem::BlockContext<FloatType> const& ctx) override
+    {
+        auto* outputData = ctx.outputData[0];
+        auto const numSamples = ctx.numSamples;
+
+        if (!ready.load())
+            return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+        for (size_t offset = 0; offset < numSamples; offset += kChunkSize) {
+            auto const n = std::min(kChunkSize, numSamples - offset);
+
+            for (size_t i = 0; i < numInputs; ++i) {
+                slots[i] = (i < ctx.numInputChannels)
+                    ? const_cast<FloatType*>(ctx.inputData[i]) + offset
+                    : zeros.data();
+            }
+
+            for (size_t i = 0; i < numConsts; ++i) {
+                std::fill_n(slots[numInputs + i], n, consts[i].load(std::memory_order_relaxed));
+            }
+
+            for (auto const& op : ops) {
+                auto* dst = slots[op.dst];
+                auto const* a = slots[op.args[0]];
+
+                switch (op.code) {
+                    case Copy:
+                        std::copy_n(a, n, dst);
+                        break;
+                    case Add: {
+                        auto const* b = slots[op.args[1]];
+                        for (size_t k = 0; k < n; ++k)
+                            dst[k] = a[k] + b[k];
+                        break;
+                    }
+                    case Sub: {
+                        auto const* b = slots[op.args[1]];
+                        for (size_t k = 0; k < n; ++k)
+                            dst[k] = a[k] - b[k];
+                        break;
+                    }
+                    case Mul: {
+                        auto const* b = slots[op.args[1]];
+                        for (size_t k = 0; k < n; ++k)
+                            dst[k] = a[k] * b[k];
+                        break;
+                    }
+                    case Select: {
+                        auto const* b = slots[op.args[1]];
+                        auto const* c = slots[op.args[2]];
+                        for (size_t k = 0; k < n; ++k)
+                            dst[k] = a[k] * b[k] + (FloatType(1) - a[k]) * c[k];
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            std::copy_n(slots[result], n, outputData + offset);
+        }
+    }
+
+private:
+    struct Op {
+        int code = Copy;
+        size_t dst = 0;
+        size_t args[3] = {0, 0, 0};
+    };
+
+    // Reads {inputs: Number, consts: Array, registers: Number, ops: Array, result: Number}
+    // where ops is a flat array of [opcode, dst, a, b, c] tuples
+    bool loadProgram(elem::js::Object const& program)
+    {
+        auto const getSize = [&](std::string const& k) -> size_t {
+            auto it = program.find(k);
+            return (it != program.end() && it->second.isNumber()) ? static_cast<size_t>(it->second.getNumber()) : 0;
+        };
+
+        auto constsIt = program.find("consts");
+        auto opsIt = program.find("ops");
+
+        if (constsIt == program.end() || !constsIt->second.isArray() || opsIt == program.end() || !opsIt->second.isArray())
+            return false;
+
+        auto const& constValues = constsIt->second.getArray();
+        auto const& flatOps = opsIt->second.getArray();
+
+        numInputs = getSize("inputs");
+        numConsts = constValues.size();
+        result = getSize("result");
+
+        auto const numRegisters = getSize("registers");
+        auto const firstRegister = numInputs + numConsts;
+        auto const numSlots = firstRegister + numRegisters;
+
+        if (flatOps.size() % 5 != 0 || result >= numSlots)
+            return false;
+
+        for (size_t i = 0; i < flatOps.size(); i += 5) {
+            Op op;
+
+            op.code = static_cast<int>(flatOps[i].getNumber());
+            op.dst = static_cast<size_t>(flatOps[i + 1].getNumber());
+
+            for (size_t j = 0; j < 3; ++j) {
+                auto const& arg = flatOps[i + 2 + j];
+                op.args[j] = arg.isNumber() && arg.getNumber() >= 0 ? static_cast<size_t>(arg.getNumber()) : 0;
+
+                if (op.args[j] >= numSlots)
+                    return false;
+            }
+
+            // Only registers may be written
+            if (op.code < Copy || op.code > Select || op.dst < firstRegister || op.dst >= numSlots)
+                return false;
+
+            ops.push_back(op);
+        }
+
+        consts = std::make_unique<std::atomic<FloatType>[]>(numConsts);
+
+        for (size_t i = 0; i < numConsts; ++i) {
+            consts[i].store(constValues[i].isNumber() ? static_cast<FloatType>(constValues[i].getNumber()) : FloatType(0));
+        }
+
+        scratch.assign((numConsts + numRegisters) * kChunkSize, FloatType(0));
+        slots.assign(numSlots, zeros.data());
+
+        for (size_t i = numInputs; i < numSlots; ++i) {
+            slots[i] = scratch.data() + (i - numInputs) * kChunkSize;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    std::atomic<bool> ready { false };
+
+    size_t numInputs = 0;
+    size_t numConsts = 0;
+    size_t result = 0;
+
+    std::vector<Op> ops;
+    std::unique_ptr<std::atomic<FloatType>[]> consts;
+
+    std::vector<FloatType> scratch;
+    std::vector<FloatType> zeros;
+    std::vector<FloatType*> slots;
+};
@@ -0,0 +1,369 @@
+#include "GraphFusion.h"
+#include "FusedElementwiseNode.h"
+
+#include <algorithm>
+
+
+namespace
+{
+    // Instruction layouts as produced by the renderer
+    enum InstructionType {
+        CreateNode = 0,      // [0, nodeId, type]
+        DeleteNode = 1,      // [1, nodeId]
+        AppendChild = 2,     // [2, parentId, childId, childOutputChannel]
+        SetProperty = 3,     // [3, nodeId, key, value]
+        ActivateRoots = 4,   // [4, [nodeId, ...]]
+        CommitUpdates = 5,   // [5]
+    };
+
+    using Opcode = FusedElementwiseNode<float>::Opcode;
+
+    int32_t toNodeId(elem::js::Value const& v)
+    {
+        return static_cast<int32_t>(v.getNumber());
+    }
+
+    elem::js::Array makeInstruction(std::initializer_list<elem::js::Value> values)
+    {
+        return elem::js::Array(values);
+    }
+}
+
+//==============================================================================
+bool GraphFusion::isFusible (NodeId id) const
+{
+    auto it = nodes.find(id);
+
+    if (it == nodes.end() || created.count(id) == 0)
+        return false;
+
+    auto const& n = it->second;
+
+    if (n.type == "add" || n.type == "sub" || n.type == "mul")
+        return true;
+
+    return n.type == "select" && n.children.size() == 3;
+}
+
+bool GraphFusion::isAbsorbed (NodeId id) const
+{
+    // A node is folded into its parent's region only if that parent is the
+    // only consumer of its output
+    auto count = parentCounts.find(id);
+    auto parent = singleParent.find(id);
+
+    return isFusible(id)
+        && count != parentCounts.end() && count->second == 1
+        && parent != singleParent.end() && isFusible(parent->second);
+}
+
+GraphFusion::NodeId GraphFusion::allocateFusedId()
+{
+    while (nodes.count(nextFusedId) > 0)
+        ++nextFusedId;
+
+    return nextFusedId++;
+}
+
+GraphFusion::Operand GraphFusion::compileChild (Region& region, Edge const& edge)
+{
+    auto const [childId, channel] = edge;
+    auto it = nodes.find(childId);
+
+    // Constants are cheap to duplicate, so we inline them even when shared
+    if (it != nodes.end() && it->second.type == "const" && created.count(childId) > 0) {
+        region.consts.push_back({childId, it->second.value});
+        region.numFused++;
+        return { Const, region.consts.size() - 1 };
+    }
+
+    if (channel == 0 && isAbsorbed(childId)) {
+        return compile(region, childId);
+    }
+
+    for (size_t i = 0; i < region.inputs.size(); ++i) {
+        if (region.inputs[i] == edge) {
+            return { Input, i };
+        }
+    }
+
+    region.inputs.push_back(edge);
+    return { Input, region.inputs.size() - 1 };
+}
+
+GraphFusion::Operand GraphFusion::compile (Region& region, NodeId id)
+{
+    auto const& n = nodes.at(id);
+    region.numFused++;
+
+    if (n.type == "select") {
+        Op op { Opcode::Select, region.numRegisters++ };
+
+        for (size_t i = 0; i < 3; ++i)
+            op.args[i] = compileChild(region, n.children[i]);
+
+        region.ops.push_back(op);
+        return { Register, op.dst };
+    }
+
+    // add, sub and mul reduce over all of their children from left to right
+    int const code = (n.type == "add") ? Opcode::Add : ((n.type == "sub") ? Opcode::Sub : Opcode::Mul);
+
+    if (n.children.empty()) {
+        region.consts.push_back({0, 0.0});
+        return { Const, region.consts.size() - 1 };
+    }
+
+    auto acc = compileChild(region, n.children[0]);
+
+    for (size_t i = 1; i < n.children.size(); ++i) {
+        Op op { code, (acc.kind == Register) ? acc.index : region.numRegisters++ };
+
+        op.args[0] = acc;
+        op.args[1] = compileChild(region, n.children[i]);
+
+        region.ops.push_back(op);
+        acc = { Register, op.dst };
+    }
+
+    return acc;
+}
+
+elem::js::Object GraphFusion::finalize (Region const& region) const
+{
+    auto const numInputs = region.inputs.size();
+    auto const numConsts = region.consts.size();
+
+    auto const flatten = [&](Operand const& o) -> double {
+        switch (o.kind) {
+            case Input: return static_cast<double>(o.index);
+            case Const: return static_cast<double>(numInputs + o.index);
+            case Register: return static_cast<double>(numInputs + numConsts + o.index);
+        }
+
+        return 0.0;
+    };
+
+    elem::js::Array consts;
+    elem::js::Array ops;
+
+    for (auto const& c : region.consts)
+        consts.push_back(elem::js::Number(c.second));
+
+    for (auto const& op : region.ops) {
+        ops.push_back(elem::js::Number(op.code));
+        ops.push_back(elem::js::Number(numInputs + numConsts + op.dst));
+
+        for (auto const& arg : op.args)
+            ops.push_back(elem::js::Number(flatten(arg)));
+    }
+
+    return elem::js::Object {
+        { "inputs", elem::js::Number(static_cast<double>(numInputs)) },
+        { "consts", consts },
+        { "registers", elem::js::Number(static_cast<double>(region.numRegisters)) },
+        { "ops", ops },
+        { "result", elem::js::Number(flatten(region.result)) },
+    };
+}
+
+//==============================================================================
+elem::js::Array GraphFusion::process (elem::js::Array const& batch)
+{
+    parentCounts.clear();
+    singleParent.clear();
+    created.clear();
+
+    lastNumFusedNodes = 0;
+    lastNumFusedKernels = 0;
+
+    // First pass: mirror the batch into our shadow graph so that we know the
+    // type, props and children of everything it creates
+    for (auto const& v : batch) {
+        if (!v.isArray() || v.getArray().empty())
+            continue;
+
+        auto const& ins = v.getArray();
+        auto const type = static_cast<int>(ins[0].getNumber());
+
+        if (type == CreateNode && ins.size() > 2 && ins[2].isString()) {
+            auto const id = toNodeId(ins[1]);
+
+            nodes[id] = ShadowNode { ins[2].getString() };
+            created.insert(id);
+        }
+
+        if (type == SetProperty && ins.size() > 3 && ins[2].isString() && ins[2].getString() == "value" && ins[3].isNumber()) {
+            auto it = nodes.find(toNodeId(ins[1]));
+
+            if (it != nodes.end())
+                it->second.value = ins[3].getNumber();
+        }
+
+        if (type == AppendChild && ins.size() > 2) {
+            auto const parentId = toNodeId(ins[1]);
+            auto const childId = toNodeId(ins[2]);
+            auto const channel = ins.size() > 3 ? toNodeId(ins[3]) : 0;
+
+            nodes[parentId].children.push_back({childId, channel});
+            parentCounts[childId]++;
+            singleParent[childId] = parentId;
+        }
+
+        if (type == ActivateRoots && ins.size() > 1 && ins[1].isArray()) {
+            for (auto const& r : ins[1].getArray())
+                parentCounts[toNodeId(r)] += 2;
+        }
+    }
+
+    // Next we compile one region for every fusible node that isn't absorbed into
+    // its parent's region, in the order the batch created them, so that the fused
+    // ids we hand out don't depend on hash order
+    std::vector<Region> regions;
+
+    for (auto const& v : batch) {
+        if (!v.isArray() || v.getArray().size() < 3 || static_cast<int>(v.getArray()[0].getNumber()) != CreateNode)
+            continue;
+
+        auto const id = toNodeId(v.getArray()[1]);
+
+        if (!isFusible(id) || isAbsorbed(id))
+            continue;
+
+        Region region;
+        region.root = id;
+        region.result = compile(region, id);
+
+        // A region of one node gains us nothing
+        if (region.numFused < 2)
+            continue;
+
+        if (region.result.kind != Register) {
+            Op op { Opcode::Copy, region.numRegisters++ };
+            op.args[0] = region.result;
+            region.ops.push_back(op);
+            region.result = { Register, op.dst };
+        }
+
+        region.fusedId = allocateFusedId();
+        fusedByRoot[id] = region.fusedId;
+
+        regions.push_back(std::move(region));
+    }
+
+    auto const resolve = [this](NodeId id) {
+        auto it = fusedByRoot.find(id);
+        return (it != fusedByRoot.end()) ? it->second : id;
+    };
+
+    // Finally, we rebuild the batch. Everything the renderer asked for goes through
+    // unchanged except that edges into fused roots are redirected, and we hold those
+    // edges back, along with root activation and commit, until the fused nodes exist.
+    elem::js::Array result;
+    elem::js::Array deferred;
+    elem::js::Array tail;
+
+    for (auto const& v : batch) {
+        if (!v.isArray() || v.getArray().empty()) {
+            result.push_back(v);
+            continue;
+        }
+
+        auto const& ins = v.getArray();
+        auto const type = static_cast<int>(ins[0].getNumber());
+
+        if (type == AppendChild && ins.size() > 2 && resolve(toNodeId(ins[2])) != toNodeId(ins[2])) {
+            auto rewritten = ins;
+            rewritten[2] = elem::js::Number(resolve(toNodeId(ins[2])));
+            deferred.push_back(rewritten);
+            continue;
+        }
+
+        if (type == ActivateRoots && ins.size() > 1 && ins[1].isArray()) {
+            elem::js::Array roots;
+
+            for (auto const& r : ins[1].getArray())
+                roots.push_back(elem::js::Number(resolve(toNodeId(r))));
+
+            tail.push_back(makeInstruction({ elem::js::Number(ActivateRoots), roots }));
+            continue;
+        }
+
+        if (type == CommitUpdates) {
+            tail.push_back(v);
+            continue;
+        }
+
+        result.push_back(v);
+
+        // Forward ref updates on fused constants, e.g. from a ref setter
+        if (type == SetProperty && ins.size() > 3 && ins[2].isString() && ins[2].getString() == "value") {
+            auto it = constSlots.find(toNodeId(ins[1]));
+
+            if (it != constSlots.end()) {
+                for (auto const& [fusedId, slot] : it->second) {
+                    result.push_back(makeInstruction({
+                        elem::js::Number(SetProperty),
+                        elem::js::Number(fusedId),
+                        elem::js::String("const" + std::to_string(slot)),
+                        ins[3],
+                    }));
+                }
+            }
+        }
+
+        if (type == DeleteNode && ins.size() > 1) {
+            auto const id = toNodeId(ins[1]);
+            auto it = fusedByRoot.find(id);
+
+            if (it != fusedByRoot.end()) {
+                auto const fusedId = it->second;
+                result.push_back(makeInstruction({ elem::js::Number(DeleteNode), elem::js::Number(fusedId) }));
+
+                for (auto& [constId, slots] : constSlots) {
+                    slots.erase(std::remove_if(slots.begin(), slots.end(), [=](auto const& s) { return s.first == fusedId; }), slots.end());
+                }
+
+                fusedByRoot.erase(it);
+            }
+
+            constSlots.erase(id);
+            nodes.erase(id);
+        }
+    }
+
+    // One region's input may be another's root, where a fused tree feeds more than
+    // one consumer, so every fused node exists before we wire up any of them
+    for (auto const& region : regions) {
+        result.push_back(makeInstruction({ elem::js::Number(CreateNode), elem::js::Number(region.fusedId), elem::js::String("fused") }));
+        result.push_back(makeInstruction({ elem::js::Number(SetProperty), elem::js::Number(region.fusedId), elem::js::String("program"), finalize(region) }));
+    }
+
+    for (auto const& region : regions) {
+        for (auto const& [childId, channel] : region.inputs)
+            result.push_back(makeInstruction({ elem::js::Number(AppendChild), elem::js::Number(region.fusedId), elem::js::Number(resolve(childId)), elem::js::Number(channel) }));
+
+        for (size_t i = 0; i < region.consts.size(); ++i) {
+            if (region.consts[i].first != 0)
+                constSlots[region.consts[i].first].push_back({region.fusedId, i});
+        }
+
+        lastNumFusedNodes += region.numFused;
+        lastNumFusedKernels++;
+    }
+
+    result.insert(result.end(), deferred.begin(), deferred.end());
+    result.insert(result.end(), tail.begin(), tail.end());
+
+    return result;
+}
+
+void GraphFusion::reset()
+{
+    nodes.clear();
+    fusedByRoot.clear();
+    constSlots.clear();
+    parentCounts.clear();
+    singleParent.clear();
+    created.clear();
+}
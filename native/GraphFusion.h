@@ -0,0 +1,108 @@
+#pragma once
+
+#include <elem/Value.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+
+//==============================================================================
+// A rewrite pass over the instruction batches coming out of the JavaScript
+// renderer, applied just before they reach elem::Runtime::applyInstructions.
+//
+// Within each batch we look for trees of newly created `mul`/`add`/`sub`/`const`/
+// `select` nodes, compile each tree into a register program, and replace it with
+// a single "fused" node (see FusedElementwiseNode) which evaluates the whole
+// tree in one pass over the block.
+//
+// The original nodes are still created and wired as the renderer asked, so any
+// later batch can keep referring to them; we only redirect the edges into the
+// root of each fused tree, which leaves the interior unreachable and thereby
+// skipped by the runtime. Later property writes to fused const nodes and deletes
+// of fused roots are forwarded to the fused node.
+//
+// One instance tracks the graph of one elem::Runtime, so it must be reset
+// whenever the runtime is replaced.
+class GraphFusion
+{
+public:
+    //==============================================================================
+    /** Rewrites a single instruction batch. */
+    elem::js::Array process (elem::js::Array const& batch);
+
+    /** Forgets all tracked graph state. */
+    void reset();
+
+    //==============================================================================
+    /** Stats from the most recent batch. */
+    size_t getNumFusedNodes() const { return lastNumFusedNodes; }
+    size_t getNumFusedKernels() const { return lastNumFusedKernels; }
+
+private:
+    //==============================================================================
+    using NodeId = int32_t;
+    using Edge = std::pair<NodeId, int32_t>;
+
+    struct ShadowNode {
+        std::string type;
+        std::vector<Edge> children;
+        double value = 0;
+    };
+
+    // Operands are encoded as (kind, index) while compiling and only flattened
+    // into the fused node's slot space once the region is complete
+    enum OperandKind { Input = 0, Const = 1, Register = 2 };
+
+    struct Operand {
+        OperandKind kind = Input;
+        size_t index = 0;
+    };
+
+    struct Op {
+        int code = 0;
+        size_t dst = 0;
+        Operand args[3];
+    };
+
+    struct Region {
+        NodeId root = 0;
+        NodeId fusedId = 0;
+        std::vector<Edge> inputs;
+        std::vector<std::pair<NodeId, double>> consts;
+        std::vector<Op> ops;
+        size_t numRegisters = 0;
+        Operand result;
+        size_t numFused = 0;
+    };
+
+    //==============================================================================
+    bool isFusible (NodeId id) const;
+    bool isAbsorbed (NodeId id) const;
+    NodeId allocateFusedId();
+
+    // Compiles the subtree at `id` into the region's program, returning the
+    // operand which holds its result
+    Operand compile (Region& region, NodeId id);
+    Operand compileChild (Region& region, Edge const& edge);
+
+    elem::js::Object finalize (Region const& region) const;
+
+    //==============================================================================
+    std::unordered_map<NodeId, ShadowNode> nodes;
+    std::unordered_map<NodeId, NodeId> fusedByRoot;
+    std::unordered_map<NodeId, std::vector<std::pair<NodeId, size_t>>> constSlots;
+
+    // Per-batch bookkeeping
+    std::unordered_map<NodeId, size_t> parentCounts;
+    std::unordered_map<NodeId, NodeId> singleParent;
+    std::unordered_set<NodeId> created;
+
+    NodeId nextFusedId = 0x7e000000;
+
+    size_t lastNumFusedNodes = 0;
+    size_t lastNumFusedKernels = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+
+//==============================================================================
+// An in-place fast Walsh-Hadamard transform across N channel buffers.
+//
+// This computes the same product as multiplying each sample frame by the
+// Sylvester-ordered Hadamard matrix (the H8 matrix we used to spell out in
+// srvb.js), scaled by sqrt(1 / N) so that the mix is orthogonal. Rather than
+// N^2 multiply-adds per frame we run N log2(N) butterflies, and each butterfly
+// runs over the whole block so that the inner loop is a plain elementwise
+// add/sub across contiguous memory which the compiler turns into SIMD.
+//
+// @see https://en.wikipedia.org/wiki/Fast_Walsh%E2%80%93Hadamard_transform
+template <typename FloatType, size_t N>
+void hadamardInPlace (std::array<FloatType*, N> const& lines, size_t numSamples)
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Hadamard size must be a power of two");
+
+    for (size_t h = 1; h < N; h *= 2) {
+        for (size_t i = 0; i < N; i += h * 2) {
+            for (size_t j = i; j < i + h; ++j) {
+                FloatType* a = lines[j];
+                FloatType* b = lines[j + h];
+
+                for (size_t k = 0; k < numSamples; ++k) {
+                    auto const x = a[k];
+                    auto const y = b[k];
+
+                    a[k] = x + y;
+                    b[k] = x - y;
+                }
+            }
+        }
+    }
+
+    auto const scale = static_cast<FloatType>(std::sqrt(1.0 / static_cast<double>(N)));
+
+    for (auto* line : lines) {
+        for (size_t k = 0; k < numSamples; ++k) {
+            line[k] *= scale;
+        }
+    }
+}
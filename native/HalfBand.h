@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+
+//==============================================================================
+// Polyphase half-band filters for changing sample rate by a factor of two.
+//
+// A half-band lowpass has every other tap equal to zero, apart from the centre tap
+// of exactly 0.5, and is symmetric about that centre. Split into its two polyphase
+// branches, one branch is a plain delay and the other a short symmetric FIR, so
+// each output sample at the lower rate costs NumPairs multiply-adds on summed pairs
+// plus one for the centre tap, however many taps the full filter has.
+//
+// The filter here has 47 taps, designed as a Blackman-windowed sinc. Its passband
+// is flat to 0.2 of the higher sample rate, about 19kHz at 96kHz, and it rejects
+// everything from 0.3 up by at least 50dB, so what little does alias lands in the
+// top of the band where the reverb's damping has already taken most of the energy.
+template <typename FloatType>
+struct HalfBandCoefficients
+{
+    // Number of non-zero, off-centre coefficient pairs, giving 4 * NumPairs - 1 taps
+    static constexpr size_t NumPairs = 12;
+
+    // The coefficient for the pair of taps at +/-(2k + 1) from the centre, for k in
+    // [0, NumPairs)
+    static std::array<FloatType, NumPairs> const& get()
+    {
+        static auto const coeffs = []() {
+            constexpr double pi = 3.141592653589793;
+            constexpr double length = 4.0 * NumPairs - 1.0;
+            constexpr double centre = (length - 1.0) / 2.0;
+
+            std::array<double, NumPairs> h {};
+            double sum = 0;
+
+            for (size_t k = 0; k < NumPairs; ++k) {
+                auto const n = static_cast<double>(2 * k + 1);
+                auto const x = (centre + n) / (length - 1.0);
+                auto const window = 0.42 - 0.5 * std::cos(2.0 * pi * x) + 0.08 * std::cos(4.0 * pi * x);
+
+                h[k] = 0.5 * std::sin(pi * n / 2.0) / (pi * n / 2.0) * window;
+                sum += 2.0 * h[k];
+            }
+
+            // Normalize for unity gain at DC, where the centre tap gives us 0.5
+            std::array<FloatType, NumPairs> result {};
+
+            for (size_t k = 0; k < NumPairs; ++k)
+                result[k] = static_cast<FloatType>(h[k] * 0.5 / sum);
+
+            return result;
+        }();
+
+        return coeffs;
+    }
+};
+
+//==============================================================================
+// A short history of samples, most recent first, kept twice over in one buffer
+// so that the last Size samples are always contiguous without any wrapping.
+template <typename FloatType, size_t Size>
+struct HalfBandHistory
+{
+    void clear()
+    {
+        data.fill(FloatType(0));
+        pos = 0;
+    }
+
+    void push (FloatType x)
+    {
+        pos = (pos == 0) ? Size - 1 : pos - 1;
+        data[pos] = data[pos + Size] = x;
+    }
+
+    /** Returns the sample pushed i samples before the most recent one. */
+    FloatType operator[] (size_t i) const { return data[pos + i]; }
+
+    std::array<FloatType, 2 * Size> data {};
+    size_t pos = 0;
+};
+
+// The symmetric FIR branch, taken over a history of 2 * NumPairs samples
+template <typename FloatType, size_t Size>
+FloatType halfBandBranch (HalfBandHistory<FloatType, Size> const& x)
+{
+    using Coeffs = HalfBandCoefficients<FloatType>;
+    static_assert(Size == 2 * Coeffs::NumPairs, "Unexpected history size");
+
+    auto const& c = Coeffs::get();
+    auto const* p = x.data.data() + x.pos;
+    FloatType y = 0;
+
+    for (size_t k = 0; k < Coeffs::NumPairs; ++k)
+        y += c[k] * (p[Coeffs::NumPairs - 1 - k] + p[Coeffs::NumPairs + k]);
+
+    return y;
+}
+
+//==============================================================================
+/** Halves the sample rate of a stream, in blocks of any length.
+
+    Input samples are consumed in pairs, so a block of odd length holds its last
+    sample back until the next call. process() returns how many samples it wrote,
+    which is at most (numSamples + 1) / 2. Writing in place is fine.
+*/
+template <typename FloatType>
+class HalfBandDecimator
+{
+public:
+    void reset()
+    {
+        even.clear();
+        odd.clear();
+        pending = 0;
+        hasPending = false;
+    }
+
+    size_t process (FloatType const* input, size_t numSamples, FloatType* output)
+    {
+        size_t numOut = 0;
+
+        for (size_t i = 0; i < numSamples; ++i) {
+            if (!hasPending) {
+                pending = input[i];
+                hasPending = true;
+                continue;
+            }
+
+            odd.push(pending);
+            even.push(input[i]);
+            hasPending = false;
+
+            output[numOut++] = halfBandBranch(even) + FloatType(0.5) * odd[Pairs - 1];
+        }
+
+        return numOut;
+    }
+
+private:
+    static constexpr size_t Pairs = HalfBandCoefficients<FloatType>::NumPairs;
+
+    HalfBandHistory<FloatType, 2 * Pairs> even;
+    HalfBandHistory<FloatType, Pairs> odd;
+    FloatType pending = 0;
+    bool hasPending = false;
+};
+
+/** Doubles the sample rate of a stream, writing 2 * numSamples samples. Not in place. */
+template <typename FloatType>
+class HalfBandInterpolator
+{
+public:
+    void reset()
+    {
+        history.clear();
+    }
+
+    void process (FloatType const* input, size_t numSamples, FloatType* output)
+    {
+        for (size_t i = 0; i < numSamples; ++i) {
+            history.push(input[i]);
+
+            // Zero stuffing doubles the filter's gain requirement, which we fold
+            // into the FIR branch, and the centre tap branch becomes a plain delay
+            output[2 * i] = FloatType(2) * halfBandBranch(history);
+            output[2 * i + 1] = history[Pairs - 1];
+        }
+    }
+
+private:
+    static constexpr size_t Pairs = HalfBandCoefficients<FloatType>::NumPairs;
+
+    HalfBandHistory<FloatType, 2 * Pairs> history;
+};
@@ -0,0 +1,222 @@
+#include "InstructionCodec.h"
+
+#include <cstring>
+
+
+namespace
+{
+    enum Tag {
+        Undefined = 0,
+        Null = 1,
+        False = 2,
+        True = 3,
+        Number = 4,
+        String = 5,
+        Array = 6,
+        Object = 7,
+        Float32Array = 8,
+    };
+
+    // Deeper than any prop value we'd ever render, and shallow enough that malformed
+    // input can't run us out of stack
+    constexpr int kMaxValueDepth = 64;
+
+    //==============================================================================
+    // A bounds-checked cursor over the encoded bytes. Every read fails, rather than
+    // overrunning, once the data runs out.
+    struct Reader
+    {
+        uint8_t const* data;
+        size_t size;
+        size_t pos = 0;
+
+        bool atEnd() const { return pos >= size; }
+
+        template <typename T>
+        bool read (T& out)
+        {
+            if (size - pos < sizeof(T))
+                return false;
+
+            std::memcpy(&out, data + pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+
+        bool readNumber (int32_t& out, elem::js::Value& v)
+        {
+            if (!read(out))
+                return false;
+
+            v = elem::js::Number(out);
+            return true;
+        }
+
+        bool readString (elem::js::Value& v)
+        {
+            uint32_t length = 0;
+
+            if (!read(length) || size - pos < length)
+                return false;
+
+            v = elem::js::String(reinterpret_cast<char const*>(data + pos), length);
+            pos += length;
+            return true;
+        }
+
+        bool readCount (uint32_t& count, size_t minBytesPerElement)
+        {
+            // Checking the count against what's left keeps a corrupt count from
+            // reserving gigabytes up front
+            return read(count) && static_cast<size_t>(count) * minBytesPerElement <= size - pos;
+        }
+
+        bool readValue (elem::js::Value& v, int depth)
+        {
+            uint8_t tag = 0;
+
+            if (depth > kMaxValueDepth || !read(tag))
+                return false;
+
+            switch (tag) {
+                case Undefined:
+                case Null:
+                    v = elem::js::Value();
+                    return true;
+                case False:
+                case True:
+                    v = elem::js::Value(tag == True);
+                    return true;
+                case Number: {
+                    double x = 0;
+
+                    if (!read(x))
+                        return false;
+
+                    v = elem::js::Number(x);
+                    return true;
+                }
+                case String:
+                    return readString(v);
+                case Array: {
+                    uint32_t count = 0;
+
+                    if (!readCount(count, 1))
+                        return false;
+
+                    elem::js::Array arr(count);
+
+                    for (auto& element : arr)
+                        if (!readValue(element, depth + 1))
+                            return false;
+
+                    v = std::move(arr);
+                    return true;
+                }
+                case Object: {
+                    uint32_t count = 0;
+
+                    if (!readCount(count, 5))
+                        return false;
+
+                    elem::js::Object obj;
+
+                    for (uint32_t i = 0; i < count; ++i) {
+                        elem::js::Value key, element;
+
+                        if (!readString(key) || !readValue(element, depth + 1))
+                            return false;
+
+                        obj.insert_or_assign(key.getString(), std::move(element));
+                    }
+
+                    v = std::move(obj);
+                    return true;
+                }
+                case Float32Array: {
+                    uint32_t count = 0;
+
+                    if (!readCount(count, sizeof(float)))
+                        return false;
+
+                    elem::js::Float32Array arr(count);
+
+                    for (auto& x : arr)
+                        read(x);
+
+                    v = std::move(arr);
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+    };
+}
+
+//==============================================================================
+bool decodeInstructionBatch (uint8_t const* data, size_t size, elem::js::Array& batch)
+{
+    Reader r { data, size };
+    batch.clear();
+
+    while (!r.atEnd()) {
+        uint8_t type = 0;
+        int32_t id = 0;
+
+        r.read(type);
+
+        elem::js::Array ins { elem::js::Number(type) };
+
+        switch (type) {
+            case 0: // create
+            case 3: // property
+                ins.resize(type == 0 ? 3 : 4);
+
+                if (!r.readNumber(id, ins[1]) || !r.readString(ins[2]))
+                    return false;
+
+                if (type == 3 && !r.readValue(ins[3], 0))
+                    return false;
+
+                break;
+            case 1: // delete
+                ins.resize(2);
+
+                if (!r.readNumber(id, ins[1]))
+                    return false;
+
+                break;
+            case 2: // append
+                ins.resize(4);
+
+                for (size_t i = 1; i < 4; ++i)
+                    if (!r.readNumber(id, ins[i]))
+                        return false;
+
+                break;
+            case 4: { // activate
+                uint32_t count = 0;
+
+                if (!r.readCount(count, sizeof(int32_t)))
+                    return false;
+
+                elem::js::Array roots(count);
+
+                for (auto& root : roots)
+                    r.readNumber(id, root);
+
+                ins.push_back(std::move(roots));
+                break;
+            }
+            case 5: // commit
+                break;
+            default:
+                return false;
+        }
+
+        batch.push_back(std::move(ins));
+    }
+
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <elem/Value.h>
+
+#include <cstddef>
+#include <cstdint>
+
+
+//==============================================================================
+// Decodes instruction batches from the compact binary encoding written by
+// dsp/batch.js, straight into the values elem::Runtime::applyInstructions takes,
+// with no intermediate string or JSON document.
+//
+// Everything is little-endian. A batch is a sequence of instructions, each an
+// opcode byte followed by its operands:
+//
+//   0  create     i32 nodeId, string type
+//   1  delete     i32 nodeId
+//   2  append     i32 parentId, i32 childId, i32 childOutputChannel
+//   3  property   i32 nodeId, string key, value
+//   4  activate   u32 count, i32 nodeId * count
+//   5  commit
+//
+// A string is a u32 byte length followed by that many bytes of UTF-8. A value is
+// a tag byte followed by its payload:
+//
+//   0  undefined      1  null           2  false          3  true
+//   4  f64            5  string         6  array: u32 count, value * count
+//   7  object: u32 count, (string key, value) * count
+//   8  Float32Array: u32 count, f32 * count
+//
+/** Decodes a whole batch, returning false if the data is malformed. */
+bool decodeInstructionBatch (uint8_t const* data, size_t size, elem::js::Array& batch);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+
+//==============================================================================
+// A bank of NumChannels delay lines sharing one interleaved ring buffer.
+//
+// Each slot of the ring holds one frame, i.e. one sample for every channel, so
+// writing a frame touches a single contiguous run of memory and the reads for
+// all channels at similar delays land on neighbouring cache lines. Each call
+// processes one frame for every channel at once: the frame is written first, then
+// every channel is read back at its own delay, which lets the compiler vectorize
+// the read position and interpolation math across channels.
+template <typename FloatType, size_t NumChannels>
+class InterleavedDelay
+{
+public:
+    using Frame = std::array<FloatType, NumChannels>;
+
+    //==============================================================================
+    /** Allocates room for delays of up to maxDelayInSamples and clears the buffer. */
+    void prepare (size_t maxDelayInSamples)
+    {
+        length = maxDelayInSamples + 2;
+        buffer.assign(length * NumChannels, FloatType(0));
+        writeIndex = 0;
+    }
+
+    /** Writes the frame, then replaces each channel with its value delayed by a whole number of samples. */
+    void process (Frame& frame, std::array<size_t, NumChannels> const& delays)
+    {
+        write(frame);
+
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            auto const d = std::min(delays[ch], length - 2);
+            auto const readIndex = (writeIndex >= d) ? writeIndex - d : writeIndex + length - d;
+
+            frame[ch] = buffer[readIndex * NumChannels + ch];
+        }
+
+        advance();
+    }
+
+    /** Writes the frame, then replaces each channel with its value at a fractional delay, linearly interpolated. */
+    void process (Frame& frame, Frame const& delays)
+    {
+        write(frame);
+
+        auto const maxDelay = static_cast<FloatType>(length - 2);
+        auto const w = static_cast<FloatType>(writeIndex);
+        auto const len = static_cast<FloatType>(length);
+
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            auto const d = std::clamp(delays[ch], FloatType(0), maxDelay);
+            auto const readPos = (w >= d) ? w - d : w - d + len;
+
+            auto const i0 = static_cast<size_t>(readPos);
+            auto const i1 = (i0 + 1 < length) ? i0 + 1 : 0;
+            auto const frac = readPos - static_cast<FloatType>(i0);
+
+            auto const y0 = buffer[i0 * NumChannels + ch];
+            auto const y1 = buffer[i1 * NumChannels + ch];
+
+            frame[ch] = y0 + frac * (y1 - y0);
+        }
+
+        advance();
+    }
+
+private:
+    //==============================================================================
+    void write (Frame const& frame)
+    {
+        std::copy(frame.begin(), frame.end(), buffer.begin() + static_cast<std::ptrdiff_t>(writeIndex * NumChannels));
+    }
+
+    void advance()
+    {
+        if (++writeIndex >= length)
+            writeIndex = 0;
+    }
+
+    //==============================================================================
+    std::vector<FloatType> buffer;
+    size_t length = 2;
+    size_t writeIndex = 0;
+};
@@ -0,0 +1,64 @@
+#include "Manifest.h"
+#include "AssetCache.h"
+
+#include <elem/JSON.h>
+
+#include <map>
+#include <mutex>
+
+
+//==============================================================================
+std::shared_ptr<Manifest const> Manifest::get (juce::File const& assetsDirectory)
+{
+    static std::mutex manifestsLock;
+    static std::map<std::string, std::shared_ptr<Manifest const>> manifests;
+
+    // The assets themselves are shared already, by directory, so we key the same way
+    auto const assets = AssetCache::get(assetsDirectory);
+    auto const key = assetsDirectory.getFullPathName().toStdString();
+
+    std::lock_guard<std::mutex> lock(manifestsLock);
+
+    if (auto it = manifests.find(key); it != manifests.end())
+        return it->second;
+
+    auto manifest = parse(assets->getText("manifest.json"));
+    manifests[key] = manifest;
+    return manifest;
+}
+
+std::shared_ptr<Manifest const> Manifest::parse (std::string const& json)
+{
+    auto result = std::make_shared<Manifest>();
+
+    if (json.empty())
+        return result;
+
+    auto manifest = elem::js::parseJSON(json);
+
+    if (!manifest.isObject())
+        return result;
+
+    auto parameters = manifest.getWithDefault("parameters", elem::js::Array());
+
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        auto descrip = parameters[i];
+
+        if (!descrip.isObject())
+            continue;
+
+        auto structural = descrip.getWithDefault("structural", elem::js::Boolean(false));
+
+        result->parameters.push_back({
+            descrip.getWithDefault("paramId", elem::js::String("unknown")),
+            descrip.getWithDefault("name", elem::js::String("Unknown")),
+            static_cast<double>(descrip.getWithDefault("min", elem::js::Number(0))),
+            static_cast<double>(descrip.getWithDefault("max", elem::js::Number(1))),
+            static_cast<double>(descrip.getWithDefault("defaultValue", elem::js::Number(0))),
+            static_cast<double>(descrip.getWithDefault("step", elem::js::Number(0))),
+            structural.isBool() && static_cast<bool>(structural),
+        });
+    }
+
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//==============================================================================
+// The plugin's manifest.json, parsed once per process and shared, read only, by
+// every plugin instance, so that a session full of instances doesn't parse the
+// same JSON once apiece.
+struct Manifest
+{
+    struct Parameter {
+        std::string paramId;
+        std::string name;
+        double minValue = 0;
+        double maxValue = 1;
+        double defaultValue = 0;
+        double step = 0;
+
+        // Structural parameters change the shape of the graph rather than a value
+        // in it, so their changes have to reach the engine for a re-render
+        bool structural = false;
+    };
+
+    std::vector<Parameter> parameters;
+
+    //==============================================================================
+    /** Returns the process-wide manifest for an assets directory, parsing it from the
+        AssetCache the first time anyone asks. Safe from any thread.
+    */
+    static std::shared_ptr<Manifest const> get (juce::File const& assetsDirectory);
+
+    /** Parses a manifest from its JSON. Anything we can't make sense of leaves it empty. */
+    static std::shared_ptr<Manifest const> parse (std::string const& json);
+};
@@ -0,0 +1,185 @@
+#include "MessageBus.h"
+
+#include <utility>
+
+
+//==============================================================================
+void MessageBus::setConnected (bool isConnected)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    connected = isConnected;
+    state.clear();
+    errors.clear();
+    logs.clear();
+    numDroppedLogs = 0;
+    profile = {};
+    telemetry = {};
+}
+
+void MessageBus::postStateChange (choc::value::ValueView const& changes)
+{
+    if (!changes.isObject())
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!connected)
+        return;
+
+    for (uint32_t i = 0; i < changes.size(); ++i) {
+        auto const member = changes.getObjectMemberAt(i);
+        state.insert_or_assign(std::string(member.name), choc::value::Value(member.value));
+    }
+}
+
+void MessageBus::postError (std::string const& name, std::string const& message)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!connected)
+        return;
+
+    // The editor only ever shows the latest, so the oldest are the ones to go
+    if (errors.size() >= kMaxErrors)
+        errors.erase(errors.begin());
+
+    errors.push_back(choc::value::createObject("",
+        "name", name,
+        "message", message));
+}
+
+void MessageBus::postLog (choc::value::ValueView const& args)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!connected)
+        return;
+
+    if (logs.size() >= kMaxLogsPerFrame) {
+        ++numDroppedLogs;
+        return;
+    }
+
+    logs.emplace_back(args);
+}
+
+void MessageBus::postProfile (choc::value::Value newProfile)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (connected)
+        profile = std::move(newProfile);
+}
+
+void MessageBus::postTelemetry (choc::value::Value newTelemetry)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (connected)
+        telemetry = std::move(newTelemetry);
+}
+
+//==============================================================================
+choc::value::Value MessageBus::flush()
+{
+    std::map<std::string, choc::value::Value> flushedState;
+    std::vector<choc::value::Value> flushedErrors, flushedLogs;
+    uint64_t flushedNumDroppedLogs = 0;
+    choc::value::Value flushedProfile, flushedTelemetry;
+
+    // We only swap everything out under the lock, and build the payload after, so
+    // that the engine thread never waits on us for long
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::swap(flushedState, state);
+        std::swap(flushedErrors, errors);
+        std::swap(flushedLogs, logs);
+        std::swap(flushedNumDroppedLogs, numDroppedLogs);
+        std::swap(flushedProfile, profile);
+        std::swap(flushedTelemetry, telemetry);
+    }
+
+    auto payload = choc::value::createObject("");
+
+    if (!flushedState.empty()) {
+        auto changes = choc::value::createObject("");
+
+        for (auto& [key, value] : flushedState)
+            changes.addMember(key, std::move(value));
+
+        payload.addMember("state", std::move(changes));
+    }
+
+    if (!flushedErrors.empty()) {
+        auto list = choc::value::createEmptyArray();
+
+        for (auto& e : flushedErrors)
+            list.addArrayElement(std::move(e));
+
+        payload.addMember("errors", std::move(list));
+    }
+
+    if (!flushedLogs.empty()) {
+        auto list = choc::value::createEmptyArray();
+
+        for (auto& l : flushedLogs)
+            list.addArrayElement(std::move(l));
+
+        payload.addMember("logs", std::move(list));
+    }
+
+    if (flushedNumDroppedLogs > 0)
+        payload.addMember("droppedLogs", static_cast<int64_t>(flushedNumDroppedLogs));
+
+    if (!flushedProfile.isVoid())
+        payload.addMember("profile", std::move(flushedProfile));
+
+    if (!flushedTelemetry.isVoid())
+        payload.addMember("telemetry", std::move(flushedTelemetry));
+
+    if (payload.size() == 0)
+        return {};
+
+    return payload;
+}
+
+std::string MessageBus::toScript (choc::value::ValueView const& payload)
+{
+    // A JSON object is already a valid JavaScript expression, so one serialize is enough
+    return "if (typeof globalThis.__receiveNativeMessages__ === 'function') globalThis.__receiveNativeMessages__("
+        + choc::json::toString(payload) + ");";
+}
+
+//==============================================================================
+std::vector<MessageBus::InboundMessage> MessageBus::decode (choc::value::ValueView const& batch)
+{
+    static std::map<std::string, InboundMessage::Type, std::less<>> const types {
+        { "ready", InboundMessage::Type::Ready },
+        { "reload", InboundMessage::Type::Reload },
+        { "setParameterValue", InboundMessage::Type::SetParameterValue },
+        { "setProfilingEnabled", InboundMessage::Type::SetProfilingEnabled },
+    };
+
+    std::vector<InboundMessage> messages;
+
+    if (!batch.isArray())
+        return messages;
+
+    for (uint32_t i = 0; i < batch.size(); ++i) {
+        auto const m = batch[i];
+
+        if (!m.isObject() || !m.hasObjectMember("type") || !m["type"].isString())
+            continue;
+
+        auto const it = types.find(m["type"].getString());
+
+        if (it == types.end())
+            continue;
+
+        messages.push_back({ it->second, m.hasObjectMember("payload") ? choc::value::Value(m["payload"]) : choc::value::Value() });
+    }
+
+    return messages;
+}
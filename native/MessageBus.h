@@ -0,0 +1,77 @@
+#pragma once
+
+#include <choc_javascript.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+//==============================================================================
+// The one channel between a processor and its editor's WebView.
+//
+// Outbound, the message and engine threads post typed messages, never the real-time
+// thread, and each type coalesces until the editor flushes the lot, once per display
+// frame, as a single call into the WebView:
+//   - state changes merge by key, the latest value for each winning
+//   - the profile and telemetry are replaced by their latest
+//   - errors queue up, keeping the most recent few
+//   - logs queue up to kMaxLogsPerFrame, and any beyond that are counted and dropped
+//
+// Nothing is kept while no editor is connected. An editor asks for the full state
+// once its page is ready.
+//
+// Inbound, the page posts its own messages in batches through __postNativeMessages__,
+// which `decode` turns into typed messages for the editor to act on.
+class MessageBus
+{
+public:
+    //==============================================================================
+    /** Connects or disconnects an editor, dropping anything still pending. */
+    void setConnected (bool isConnected);
+
+    /** Posting is safe from any thread but the real-time one. */
+    void postStateChange (choc::value::ValueView const& changes);
+    void postError (std::string const& name, std::string const& message);
+    void postLog (choc::value::ValueView const& args);
+    void postProfile (choc::value::Value profile);
+    void postTelemetry (choc::value::Value telemetry);
+
+    /** Takes everything posted since the last flush as one payload, or a void value if
+        there's nothing to send. Message thread only.
+    */
+    choc::value::Value flush();
+
+    /** The script that hands a flushed payload to the page. */
+    static std::string toScript (choc::value::ValueView const& payload);
+
+    //==============================================================================
+    struct InboundMessage {
+        enum class Type { Ready, Reload, SetParameterValue, SetProfilingEnabled };
+
+        Type type;
+        choc::value::Value payload;
+    };
+
+    /** Reads a batch from the page, skipping any messages we don't recognise. */
+    static std::vector<InboundMessage> decode (choc::value::ValueView const& batch);
+
+    //==============================================================================
+    static constexpr size_t kMaxLogsPerFrame = 64;
+    static constexpr size_t kMaxErrors = 8;
+
+private:
+    //==============================================================================
+    std::mutex lock;
+    bool connected = false;
+
+    std::map<std::string, choc::value::Value> state;
+    std::vector<choc::value::Value> errors;
+    std::vector<choc::value::Value> logs;
+    uint64_t numDroppedLogs = 0;
+
+    choc::value::Value profile;
+    choc::value::Value telemetry;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <elem/GraphNode.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+//==============================================================================
+// Opt-in, lock-free timing of native graph nodes.
+//
+// Every profiled node, or named stage within one, accumulates its time into an
+// Entry, found by name. Entries live in one fixed table that is never reallocated
+// or shrunk, so the audio thread can hold on to an Entry* for as long as it likes
+// and only ever does two relaxed atomic adds per measurement. The message thread
+// reads the running totals at any time, without any locking against audio.
+//
+// Names follow the node's key where it has one (e.g. "srvb:net:1"), and the node
+// type and id where it doesn't (e.g. "fused#1f"), with stages named after their
+// node ("srvb:net:1/fdn"). The part up to the first ':', '#' or '/' groups entries
+// into subgraphs for display.
+class NodeProfiler
+{
+public:
+    static constexpr size_t kMaxEntries = 256;
+
+    struct Entry {
+        std::string name;
+        std::atomic<uint64_t> nanos { 0 };
+        std::atomic<uint64_t> calls { 0 };
+    };
+
+    struct Reading {
+        std::string name;
+        uint64_t nanos = 0;
+        uint64_t calls = 0;
+    };
+
+    //==============================================================================
+    NodeProfiler()
+        : entries(std::make_unique<Entry[]>(kMaxEntries))
+    {
+        entries[0].name = "other";
+        numEntries.store(1);
+    }
+
+    /** Turns measurement on or off. Safe from any thread. */
+    void setEnabled (bool shouldBeEnabled) { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /** A monotonic timestamp in nanoseconds. */
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    //==============================================================================
+    /** Finds or adds the entry for a name. Not for the audio thread.
+
+        Once the table is full, everything new shares the "other" entry.
+    */
+    Entry* acquire (std::string const& name)
+    {
+        std::lock_guard<std::mutex> lock(acquireLock);
+        auto const n = numEntries.load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < n; ++i)
+            if (entries[i].name == name)
+                return &entries[i];
+
+        if (n == kMaxEntries)
+            return &entries[0];
+
+        entries[n].name = name;
+        numEntries.store(n + 1, std::memory_order_release);
+
+        return &entries[n];
+    }
+
+    /** Adds one measurement to an entry. Audio thread. */
+    static void record (Entry* entry, uint64_t nanos)
+    {
+        entry->nanos.fetch_add(nanos, std::memory_order_relaxed);
+        entry->calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Returns the running totals of every entry. Safe from any thread but the audio thread's. */
+    std::vector<Reading> read() const
+    {
+        auto const n = numEntries.load(std::memory_order_acquire);
+        std::vector<Reading> readings;
+        readings.reserve(n);
+
+        for (size_t i = 0; i < n; ++i)
+            readings.push_back({ entries[i].name, entries[i].nanos.load(std::memory_order_relaxed), entries[i].calls.load(std::memory_order_relaxed) });
+
+        return readings;
+    }
+
+    /** The subgraph an entry belongs to: its name up to the first ':', '#' or '/'. */
+    static std::string groupOf (std::string const& name)
+    {
+        return name.substr(0, name.find_first_of(":#/"));
+    }
+
+private:
+    std::unique_ptr<Entry[]> entries;
+    std::atomic<size_t> numEntries { 0 };
+    std::atomic<bool> enabled { false };
+    std::mutex acquireLock;
+};
+
+//==============================================================================
+// Wraps a node type so that each call to process() is timed into the profiler,
+// under the node's key once it has one.
+//
+// Timing costs two clock reads per block, and nothing at all while the profiler is
+// disabled beyond one relaxed load.
+template <typename FloatType, typename NodeType>
+struct ProfiledNode : public NodeType
+{
+    template <typename... Args>
+    ProfiledNode(NodeProfiler& p, std::string const& type, elem::NodeId id, double sampleRate, int const blockSize, Args&&... args)
+        : NodeType(id, sampleRate, blockSize, std::forward<Args>(args)...)
+        , profiler(p)
+    {
+        std::ostringstream name;
+        name << type << "#" << std::hex << id;
+
+        entry.store(profiler.acquire(name.str()));
+    }
+
+    int setProperty(std::string const& key, elem::js::Value const& val) override
+    {
+        if (key == "key" && val.isString())
+            entry.store(profiler.acquire(val.getString()), std::memory_order_release);
+
+        return NodeType::setProperty(key, val);
+    }
+
+    void process (elem::BlockContext<FloatType> const& ctx) override
+    {
+        if (!profiler.isEnabled())
+            return NodeType::process(ctx);
+
+        auto const start = NodeProfiler::now();
+        NodeType::process(ctx);
+        NodeProfiler::record(entry.load(std::memory_order_acquire), NodeProfiler::now() - start);
+    }
+
+    NodeProfiler& profiler;
+    std::atomic<NodeProfiler::Entry*> entry { nullptr };
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <elem/GraphNode.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//==============================================================================
+// Host parameter values, as seen by the audio thread.
+//
+// The processor writes new values from whichever thread the host reports a change
+// on, and the audio thread latches them once per block in advance(). Each block then
+// carries a start and end value per parameter, which ParamNode ramps between, so
+// automation lands in the graph within the block it arrives in without any trip
+// through the JavaScript engine.
+//
+// That's one ramp per host block, however many runtime chunks the block is split
+// into: the processor marks where each chunk starts with beginChunk(), and each
+// chunk runs over its own stretch of the block's ramp.
+class ParameterBlock
+{
+public:
+    struct Entry {
+        std::string paramId;
+        float minValue = 0;
+        float maxValue = 1;
+        float start = 0;
+        float end = 0;
+        std::atomic<float> target { 0 };
+    };
+
+    //==============================================================================
+    /** Allocates one entry per parameter; must happen before any audio processing. */
+    void reset (std::vector<std::string> const& paramIds, std::vector<float> const& minValues, std::vector<float> const& maxValues, std::vector<float> const& defaultValues)
+    {
+        numEntries = paramIds.size();
+        entries = std::make_unique<Entry[]>(numEntries);
+
+        for (size_t i = 0; i < numEntries; ++i) {
+            entries[i].paramId = paramIds[i];
+            entries[i].minValue = minValues[i];
+            entries[i].maxValue = maxValues[i];
+            entries[i].start = entries[i].end = defaultValues[i];
+            entries[i].target.store(defaultValues[i]);
+        }
+    }
+
+    /** Sets a parameter's target from its normalized [0, 1] value. Safe from any thread. */
+    void setNormalizedValue (size_t index, float normalizedValue)
+    {
+        if (index < numEntries) {
+            auto& e = entries[index];
+            e.target.store(e.minValue + normalizedValue * (e.maxValue - e.minValue), std::memory_order_relaxed);
+        }
+    }
+
+    /** Latches the latest targets for the next host block, of numSamples samples. Audio
+        thread only.
+    */
+    void advance (size_t numSamples)
+    {
+        for (size_t i = 0; i < numEntries; ++i) {
+            entries[i].start = entries[i].end;
+            entries[i].end = entries[i].target.load(std::memory_order_relaxed);
+        }
+
+        blockSize = numSamples;
+        chunkOffset = 0;
+    }
+
+    /** Marks the next chunk the runtime processes as starting offset samples into the
+        host block. Audio thread only.
+    */
+    void beginChunk (size_t offset) { chunkOffset = offset; }
+
+    size_t getBlockSize() const { return blockSize; }
+    size_t getChunkOffset() const { return chunkOffset; }
+
+    //==============================================================================
+    Entry const* find (std::string const& paramId) const
+    {
+        for (size_t i = 0; i < numEntries; ++i)
+            if (entries[i].paramId == paramId)
+                return &entries[i];
+
+        return nullptr;
+    }
+
+private:
+    std::unique_ptr<Entry[]> entries;
+    size_t numEntries = 0;
+
+    size_t blockSize = 0;
+    size_t chunkOffset = 0;
+};
+
+//==============================================================================
+// Outputs the current value of one host parameter, identified by its "paramId"
+// prop, ramping linearly across the host block from the previous block's value.
+//
+// Expects the runtime's userData to point at the processor's ParameterBlock.
+template <typename FloatType>
+struct ParamNode : public elem::GraphNode<FloatType>
+{
+    ParamNode(elem::NodeId id, double sampleRate, int const blockSize)
+        : elem::GraphNode<FloatType>::GraphNode(id, sampleRate, blockSize)
+    {}
+
+    int setProperty(std::string const& key, elem::js::Value const& val) override
+    {
+        if (key == "paramId") {
+            if (!val.isString())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            // A different paramId renders as a different node, so this is set
+            // exactly once, before the audio thread ever sees us
+            if (!paramId.empty())
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            paramId = val.getString();
+        }
+
+        return elem::GraphNode<FloatType>::setProperty(key, val);
+    }
+
+    void process (elem::BlockContext<FloatType> const& ctx) override
+    {
+        auto* outputData = ctx.outputData[0];
+        auto const numSamples = ctx.numSamples;
+
+        auto const* block = static_cast<ParameterBlock const*>(ctx.userData);
+
+        if (entry == nullptr && block != nullptr)
+            entry = block->find(paramId);
+
+        if (entry == nullptr || numSamples == 0)
+            return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+        // This chunk covers [offset, offset + numSamples) of the host block's ramp.
+        // Without a block to go by, the chunk is the block.
+        auto const blockSize = (block != nullptr) ? block->getBlockSize() : 0;
+        auto const offset = (blockSize > 0) ? block->getChunkOffset() : 0;
+        auto const length = std::max(blockSize, offset + numSamples);
+
+        auto const start = static_cast<FloatType>(entry->start);
+        auto const step = (static_cast<FloatType>(entry->end) - start) / static_cast<FloatType>(length);
+
+        for (size_t i = 0; i < numSamples; ++i) {
+            outputData[i] = start + step * static_cast<FloatType>(offset + i + 1);
+        }
+    }
+
+    std::string paramId;
+    ParameterBlock::Entry const* entry = nullptr;
+};
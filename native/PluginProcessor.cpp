@@ -1,13 +1,74 @@
 #include "PluginProcessor.h"
-#include "WebViewEditor.h"
+#include "AssetCache.h"
+#include "FusedElementwiseNode.h"
+#include "InstructionCodec.h"
+#include "Manifest.h"
+#include "SRVBNode.h"
+
+#if ! ELEM_HEADLESS
+ #include "WebViewEditor.h"
+#endif
 
-#include <choc_javascript_QuickJS.h>
+#if ELEM_RT_SANITIZER
+ #include "RealtimeSanitizer.h"
+#endif
 
 
 //==============================================================================
+// Converts processor state into a choc value that we can hand straight to a
+// JavaScript function, without a round trip through a JSON string
+static choc::value::Value toChocValue(elem::js::Value const& v)
+{
+    if (v.isNumber())
+        return choc::value::createFloat64(v.getNumber());
+
+    if (v.isBool())
+        return choc::value::createBool(v.getBool());
+
+    if (v.isString())
+        return choc::value::createString(v.getString());
+
+    if (v.isArray()) {
+        auto result = choc::value::createEmptyArray();
+
+        for (auto const& element : v.getArray())
+            result.addArrayElement(toChocValue(element));
+
+        return result;
+    }
+
+    if (v.isObject()) {
+        auto result = choc::value::createObject("");
+
+        for (auto const& [key, element] : v.getObject())
+            result.addMember(key, toChocValue(element));
+
+        return result;
+    }
+
+    return {};
+}
+
+//==============================================================================
+// Headless tools, which don't live inside a plugin bundle, point us at their
+// assets explicitly
+static juce::File& getAssetsDirectoryOverride()
+{
+    static juce::File dir;
+    return dir;
+}
+
+void setAssetsDirectory(juce::File const& dir)
+{
+    getAssetsDirectoryOverride() = dir;
+}
+
 // A quick helper for locating bundled asset files
 juce::File getAssetsDirectory()
 {
+    if (getAssetsDirectoryOverride() != juce::File())
+        return getAssetsDirectoryOverride();
+
 #if JUCE_MAC
     auto assetsDir = juce::File::getSpecialLocation(juce::File::SpecialLocationType::currentApplicationFile)
         .getChildFile("Contents/Resources/dist");
@@ -16,8 +77,13 @@ juce::File getAssetsDirectory()
         .getParentDirectory()  // Plugin.vst3/Contents/<arch>/
         .getParentDirectory()  // Plugin.vst3/Contents/
         .getChildFile("Resources/dist");
+#elif JUCE_LINUX
+    auto assetsDir = juce::File::getSpecialLocation(juce::File::SpecialLocationType::currentExecutableFile) // Plugin.vst3/Contents/<arch>-linux/Plugin.so
+        .getParentDirectory()  // Plugin.vst3/Contents/<arch>-linux/
+        .getParentDirectory()  // Plugin.vst3/Contents/
+        .getChildFile("Resources/dist");
 #else
-#error "We only support Mac and Windows here yet."
+#error "We only support Mac, Windows and Linux here yet."
 #endif
 
     return assetsDir;
@@ -28,60 +94,68 @@ EffectsPluginProcessor::EffectsPluginProcessor()
      : AudioProcessor (BusesProperties()
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
-     , jsContext(choc::javascript::createQuickJSContext())
 {
     // Initialize parameters from the manifest file
 #if ELEM_DEV_LOCALHOST
     auto manifestFile = juce::URL("http://localhost:5173/manifest.json");
-    auto manifestFileContents = manifestFile.readEntireTextStream().toStdString();
+    auto const manifest = Manifest::parse(manifestFile.readEntireTextStream().toStdString());
 #else
-    auto manifestFile = getAssetsDirectory().getChildFile("manifest.json");
-
-    if (!manifestFile.existsAsFile())
-        return;
-
-    auto manifestFileContents = manifestFile.loadFileAsString().toStdString();
+    // Every instance shares the one manifest, which we only load and parse once
+    auto const manifest = Manifest::get(getAssetsDirectory());
 #endif
 
-    auto manifest = elem::js::parseJSON(manifestFileContents);
-
-    if (!manifest.isObject())
-        return;
-
-    auto parameters = manifest.getWithDefault("parameters", elem::js::Array());
-
-    for (size_t i = 0; i < parameters.size(); ++i) {
-        auto descrip = parameters[i];
-
-        if (!descrip.isObject())
-            continue;
-
-        auto paramId = descrip.getWithDefault("paramId", elem::js::String("unknown"));
-        auto name = descrip.getWithDefault("name", elem::js::String("Unknown"));
-        auto minValue = descrip.getWithDefault("min", elem::js::Number(0));
-        auto maxValue = descrip.getWithDefault("max", elem::js::Number(1));
-        auto defValue = descrip.getWithDefault("defaultValue", elem::js::Number(0));
+    std::vector<std::string> paramIds;
+    std::vector<float> minValues, maxValues, defaultValues;
 
+    for (auto const& descrip : manifest->parameters) {
         auto* p = new juce::AudioParameterFloat(
-            juce::ParameterID(paramId, 1),
-            name,
-            {static_cast<float>(minValue), static_cast<float>(maxValue)},
-            defValue
+            juce::ParameterID(descrip.paramId, 1),
+            descrip.name,
+            {static_cast<float>(descrip.minValue), static_cast<float>(descrip.maxValue), static_cast<float>(descrip.step)},
+            static_cast<float>(descrip.defaultValue)
         );
 
+        if (descrip.structural)
+            structuralParamIds.insert(descrip.paramId);
+
         p->addListener(this);
         addParameter(p);
 
         // Push a new ParameterReadout onto the list to represent this parameter
-        paramReadouts.emplace_back(ParameterReadout { static_cast<float>(defValue), false });
+        paramReadouts.emplace_back(ParameterReadout { static_cast<float>(descrip.defaultValue), false });
 
         // Update our state object with the default parameter value
-        state.insert_or_assign(paramId, defValue);
+        state.insert_or_assign(descrip.paramId, elem::js::Number(descrip.defaultValue));
+
+        paramIds.push_back(descrip.paramId);
+        minValues.push_back(static_cast<float>(descrip.minValue));
+        maxValues.push_back(static_cast<float>(descrip.maxValue));
+        defaultValues.push_back(static_cast<float>(descrip.defaultValue));
     }
+
+    // Set up the values that `param` nodes read on the real-time thread
+    parameterBlock.reset(paramIds, minValues, maxValues, defaultValues);
+
+    if (ELEM_PARALLEL_PROCESSING)
+        setParallelProcessingEnabled(true);
+
+    // Periodically clean up runtimes the real-time thread has swapped out
+    startTimer(500);
 }
 
 EffectsPluginProcessor::~EffectsPluginProcessor()
 {
+    // The engine thread goes first, because its jobs refer back to us. After that,
+    // and with the host no longer calling processBlock, every runtime we still own
+    // can go
+    engineThread.stop();
+
+    stopTimer();
+    freeRetiredRuntimes();
+
+    delete pendingRuntime.exchange(nullptr);
+    delete audioRuntime;
+
     for (auto& p : getParameters())
     {
         p->removeListener(this);
@@ -91,12 +165,20 @@ EffectsPluginProcessor::~EffectsPluginProcessor()
 //==============================================================================
 juce::AudioProcessorEditor* EffectsPluginProcessor::createEditor()
 {
+#if ELEM_HEADLESS
+    return nullptr;
+#else
     return new WebViewEditor(this, getAssetsDirectory(), 800, 704);
+#endif
 }
 
 bool EffectsPluginProcessor::hasEditor() const
 {
+#if ELEM_HEADLESS
+    return false;
+#else
     return true;
+#endif
 }
 
 //==============================================================================
@@ -122,7 +204,30 @@ bool EffectsPluginProcessor::isMidiEffect() const
 
 double EffectsPluginProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    double size = 0.5;
+    double decay = 0.5;
+    size_t numLines = 8;
+    auto const numChannels = static_cast<size_t>(lastKnownNumChannels.load());
+
+    for (auto* p : getParameters()) {
+        if (auto* pf = dynamic_cast<juce::AudioParameterFloat const*>(p)) {
+            if (pf->paramID == "size")
+                size = pf->get();
+
+            if (pf->paramID == "decay")
+                decay = pf->get();
+
+            // Quality steps through 4, 8 and 16 lines
+            if (pf->paramID == "quality")
+                numLines = size_t(4) << juce::jlimit(0, 2, juce::roundToInt(pf->get()));
+        }
+    }
+
+    // The network's feedback latency is the block size it was prepared with, which is
+    // always the runtime's, whatever the host's. At a reduced wet rate it's a fraction
+    // of the samples at the same fraction of the rate, which comes to the same time.
+    return SRVBNode<float>::getTailLengthSeconds(size, decay, lastKnownSampleRate.load(), kRuntimeBlockSize,
+                                                 SRVBNode<float>::getNumLinesFor(numLines, numChannels));
 }
 
 //==============================================================================
@@ -142,22 +247,33 @@ const juce::String EffectsPluginProcessor::getProgramName (int /* index */) { re
 void EffectsPluginProcessor::changeProgramName (int /* index */, const juce::String& /* newName */) {}
 
 //==============================================================================
-void EffectsPluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+void EffectsPluginProcessor::prepareToPlay (double sampleRate, int /* samplesPerBlock */)
 {
     // Some hosts call `prepareToPlay` on the real-time thread, some call it on the main thread.
     // To address the discrepancy, we check whether anything has changed since our last known
-    // call. If it has, we flag for initialization of the Elementary engine and runtime, then
-    // trigger an async update.
+    // call. If the sample rate has, we flag for a new runtime, then trigger an async update.
     //
     // JUCE will synchronously handle the async update if it understands
     // that we're already on the main thread.
-    if (sampleRate != lastKnownSampleRate || samplesPerBlock != lastKnownBlockSize) {
-        lastKnownSampleRate = sampleRate;
-        lastKnownBlockSize = samplesPerBlock;
-
+    //
+    // Either way nothing here blocks: the new runtime is built on the engine thread and
+    // only handed to the real-time thread once it's ready, see publishRuntime.
+    //
+    // The block size doesn't matter to the runtime, which takes host blocks of any size
+    // in chunks, so a host that changes it on transport start or for a bounce keeps
+    // the runtime, and the tail in it, as is.
+    if (sampleRate != lastKnownSampleRate.load()) {
+        lastKnownSampleRate.store(sampleRate);
         shouldInitialize.store(true);
     }
 
+    // The graph has one output per channel of the main output bus, all from one
+    // network, so a new layout renders a new graph from scratch into a fresh runtime
+    auto const numChannels = std::max(1, getMainBusNumOutputChannels());
+
+    if (numChannels != lastKnownNumChannels.exchange(numChannels))
+        shouldInitialize.store(true);
+
     // Now that the environment is set up, push our current state
     triggerAsyncUpdate();
 }
@@ -170,32 +286,220 @@ void EffectsPluginProcessor::releaseResources()
 
 bool EffectsPluginProcessor::isBusesLayoutSupported (const AudioProcessor::BusesLayout& layouts) const
 {
-    return true;
+    // Any output layout the network has channels for, from mono up to a 9.1.6 bed,
+    // fed from the same layout, or from mono or stereo
+    auto const numOutputs = layouts.getMainOutputChannels();
+    auto const numInputs = layouts.getMainInputChannels();
+
+    if (numOutputs < 1 || numOutputs > static_cast<int>(SRVBNode<float>::MaxChannels))
+        return false;
+
+    return numInputs == numOutputs || (numInputs >= 1 && numInputs <= 2);
 }
 
 void EffectsPluginProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& /* midiMessages */)
 {
-    // Copy the input so that our input and output buffers are distinct
-    scratchBuffer.makeCopyOf(buffer, true);
-
-    // Clear the output buffer to prevent any garbage if our runtime isn't ready
-    buffer.clear();
-
-    // Process the elementary runtime
-    if (runtime != nullptr) {
-        runtime->process(
-            const_cast<const float**>(scratchBuffer.getArrayOfWritePointers()),
-            getTotalNumInputChannels(),
-            const_cast<float**>(buffer.getArrayOfWritePointers()),
-            buffer.getNumChannels(),
-            buffer.getNumSamples(),
-            nullptr
-        );
+#if ELEM_RT_SANITIZER
+    RealtimeSanitizer::ScopedRealtime realtimeScope;
+#endif
+
+    auto const blockStart = NodeProfiler::now();
+    blockTelemetry.reset(telemetryEnabled.load(std::memory_order_relaxed));
+
+    // Pick up a newly published runtime at the block boundary. We only take it if
+    // we have room to hand back the one it replaces, which we must never delete here.
+    if (retiredRuntimesFifo.getFreeSpace() > 0) {
+        if (auto* next = pendingRuntime.exchange(nullptr, std::memory_order_acq_rel)) {
+            if (audioRuntime != nullptr) {
+                const juce::AbstractFifo::ScopedWrite scope (retiredRuntimesFifo, 1);
+                retiredRuntimes[static_cast<size_t>(scope.startIndex1)] = audioRuntime;
+            }
+
+            audioRuntime = next;
+
+            // A new runtime starts out active, whatever the old one was doing
+            idle = false;
+            numSilentSamples = 0;
+        }
     }
+
+    auto const numSamples = buffer.getNumSamples();
+
+    // Latch the latest host parameter values for this block, which the runtime ramps
+    // across once, however many chunks it takes the block in
+    parameterBlock.advance(static_cast<size_t>(numSamples));
+
+    // While idle we skip the runtime entirely, until the input has something in it.
+    // The network was already silent when we stopped running it, so picking up again
+    // from where it left off is seamless.
+    auto const numInputChannels = std::min(getTotalNumInputChannels(), buffer.getNumChannels());
+    auto inputPeak = 0.0f;
+
+    for (int ch = 0; ch < numInputChannels; ++ch)
+        inputPeak = std::max(inputPeak, buffer.getMagnitude(ch, 0, numSamples));
+
+    if (idle) {
+        if (inputPeak < kIdleThreshold) {
+            buffer.clear();
+            return finishBlock(buffer, blockStart, true);
+        }
+
+        idle = false;
+        numSilentSamples = 0;
+        isIdle.store(false, std::memory_order_relaxed);
+    }
+
+    // Process the elementary runtime, in chunks of at most the block size it was built for.
+    // Without a runtime yet, we output silence rather than whatever the host gave us.
+    if (audioRuntime == nullptr) {
+        buffer.clear();
+    } else {
+        auto const profiling = profiler.isEnabled();
+        auto const start = profiling ? NodeProfiler::now() : 0;
+
+        auto const numIns = std::min({ numInputChannels, chunkInputBuffer.getNumChannels(), kMaxChannels });
+        auto const numOuts = std::min(buffer.getNumChannels(), kMaxChannels);
+
+        // Feedback in the wet network decays into the denormal range on long silent
+        // tails, where arithmetic gets very slow on most CPUs, so the runtime always
+        // runs with denormals flushed to zero
+        juce::ScopedNoDenormals noDenormals;
+
+        // Only offline renders can afford to wait on other threads. A real-time block
+        // never does, however large.
+        blockPipeline = isNonRealtime() ? parallelPipeline.load(std::memory_order_acquire) : nullptr;
+
+        // The path we compare against in the benchmark: the whole host block in one go,
+        // from a copy of its input, with a runtime built for blocks that size. Nothing
+        // else ever takes it.
+        auto const wholeBlock = wholeBlockSize > 0 && numSamples <= wholeBlockSize;
+
+        if (wholeBlock) {
+            wholeBlockInputBuffer.makeCopyOf(buffer, true);
+
+            for (int ch = 0; ch < numIns; ++ch)
+                chunkInputs[static_cast<size_t>(ch)] = wholeBlockInputBuffer.getReadPointer(ch);
+
+            for (int ch = 0; ch < numOuts; ++ch) {
+                buffer.clear(ch, 0, numSamples);
+                chunkOutputs[static_cast<size_t>(ch)] = buffer.getWritePointer(ch);
+            }
+
+            audioRuntime->process(
+                chunkInputs.data(),
+                numIns,
+                chunkOutputs.data(),
+                numOuts,
+                numSamples,
+                &parameterBlock
+            );
+        } else {
+            // The runtime writes into the host's buffer, in place of the input it reads, so
+            // each chunk of input goes aside first. Only ever one chunk, into a buffer sized
+            // once for as many channels as we take, so none of this allocates however large
+            // the host's blocks, or whatever the layout.
+            for (int offset = 0; offset < numSamples; offset += kRuntimeBlockSize) {
+                auto const n = std::min(kRuntimeBlockSize, numSamples - offset);
+
+                for (int ch = 0; ch < numIns; ++ch) {
+                    chunkInputBuffer.copyFrom(ch, 0, buffer, ch, offset, n);
+                    chunkInputs[static_cast<size_t>(ch)] = chunkInputBuffer.getReadPointer(ch);
+                }
+
+                for (int ch = 0; ch < numOuts; ++ch) {
+                    buffer.clear(ch, offset, n);
+                    chunkOutputs[static_cast<size_t>(ch)] = buffer.getWritePointer(ch, offset);
+                }
+
+                parameterBlock.beginChunk(static_cast<size_t>(offset));
+
+                audioRuntime->process(
+                    chunkInputs.data(),
+                    numIns,
+                    chunkOutputs.data(),
+                    numOuts,
+                    n,
+                    &parameterBlock
+                );
+            }
+        }
+
+        if (profiling)
+            NodeProfiler::record(runtimeProfileEntry, NodeProfiler::now() - start);
+    }
+
+    // Once both input and output have stayed below the threshold for longer than any
+    // trip through the network, there's no energy left in it anywhere, and we go idle.
+    // The tail rings on different lines in each output, so we look at all of them.
+    auto outputPeak = 0.0f;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        outputPeak = std::max(outputPeak, buffer.getMagnitude(ch, 0, numSamples));
+
+    if (inputPeak < kIdleThreshold && outputPeak < kIdleThreshold) {
+        numSilentSamples += numSamples;
+    } else {
+        numSilentSamples = 0;
+    }
+
+    if (numSilentSamples >= static_cast<juce::int64>(kIdleHoldSeconds * lastKnownSampleRate.load(std::memory_order_relaxed))) {
+        idle = true;
+        isIdle.store(true, std::memory_order_relaxed);
+    }
+
+    finishBlock(buffer, blockStart, false);
+}
+
+void EffectsPluginProcessor::finishBlock(juce::AudioBuffer<float> const& buffer, uint64_t startNanos, bool wasIdle)
+{
+    auto const numSamples = buffer.getNumSamples();
+    auto const sampleRate = lastKnownSampleRate.load(std::memory_order_relaxed);
+
+    auto const elapsedNanos = NodeProfiler::now() - startNanos;
+    auto const budgetNanos = (sampleRate > 0) ? static_cast<uint64_t>(numSamples * 1.0e9 / sampleRate) : 0;
+
+    if (elapsedNanos > budgetNanos)
+        numOverruns.fetch_add(1, std::memory_order_relaxed);
+
+    if (!blockTelemetry.enabled)
+        return;
+
+    if (telemetryFifo.getFreeSpace() == 0) {
+        numDroppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TelemetryFrame frame;
+    frame.numSamples = static_cast<uint32_t>(numSamples);
+    frame.processNanos = static_cast<uint32_t>(std::min<uint64_t>(elapsedNanos, std::numeric_limits<uint32_t>::max()));
+    frame.budgetNanos = static_cast<uint32_t>(std::min<uint64_t>(budgetNanos, std::numeric_limits<uint32_t>::max()));
+    frame.wetSumOfSquares = static_cast<float>(blockTelemetry.wetSumOfSquares);
+    frame.numWetChannels = blockTelemetry.numWetChannels;
+    frame.idle = wasIdle;
+
+    // Every output channel meters separately, as many as the layout has
+    static_assert(TelemetryFrame::kMaxChannels >= SRVBNode<float>::MaxChannels, "Telemetry frames must have room for every output channel");
+
+    auto const numOutputs = std::min(getTotalNumOutputChannels(), buffer.getNumChannels());
+    frame.numChannels = static_cast<uint32_t>(juce::jlimit(0, static_cast<int>(TelemetryFrame::kMaxChannels), numOutputs));
+
+    for (int ch = 0; ch < static_cast<int>(frame.numChannels) && numSamples > 0; ++ch) {
+        auto const rms = buffer.getRMSLevel(ch, 0, numSamples);
+
+        frame.peak[static_cast<size_t>(ch)] = buffer.getMagnitude(ch, 0, numSamples);
+        frame.sumOfSquares[static_cast<size_t>(ch)] = rms * rms * static_cast<float>(numSamples);
+    }
+
+    const juce::AbstractFifo::ScopedWrite scope (telemetryFifo, 1);
+    telemetryFrames[static_cast<size_t>(scope.startIndex1)] = frame;
 }
 
 void EffectsPluginProcessor::parameterValueChanged (int parameterIndex, float newValue)
 {
+    // Hand the new value straight to the real-time thread, where `param` nodes pick
+    // it up on the next block
+    parameterBlock.setNormalizedValue(static_cast<size_t>(parameterIndex), newValue);
+
     // Mark the updated parameter value in the dirty list
     auto& pr = *std::next(paramReadouts.begin(), parameterIndex);
 
@@ -211,18 +515,12 @@ void EffectsPluginProcessor::parameterGestureChanged (int, bool)
 //==============================================================================
 void EffectsPluginProcessor::handleAsyncUpdate()
 {
-    // First things first, we check the flag to identify if we should initialize the Elementary
-    // runtime and engine.
-    if (shouldInitialize.exchange(false)) {
-        // TODO: This is definitely not thread-safe! It could delete a Runtime instance while
-        // the real-time thread is using it. Depends on when the host will call prepareToPlay.
-        runtime = std::make_unique<elem::Runtime<float>>(lastKnownSampleRate, lastKnownBlockSize);
-        initJavaScriptEngine();
-    }
-
-    // Next we iterate over the current parameter values to update our local state
-    // object, which we in turn dispatch into the JavaScript engine
+    // First, we iterate over the current parameter values to update our local state
+    // object, collecting everything that changed since we last looked into a single
+    // delta for dispatch
     auto& params = getParameters();
+    elem::js::Object changes;
+    bool includeEngine = false;
 
     // Reduce over the changed parameters to resolve our updated processor state
     for (size_t i = 0; i < paramReadouts.size(); ++i)
@@ -239,56 +537,393 @@ void EffectsPluginProcessor::handleAsyncUpdate()
         {
             if (auto* pf = dynamic_cast<juce::AudioParameterFloat*>(params[i])) {
                 auto paramId = pf->paramID.toStdString();
-                state.insert_or_assign(paramId, elem::js::Number(pr.value));
+                auto value = elem::js::Number(pf->convertFrom0to1(pr.value));
+
+                state.insert_or_assign(paramId, value);
+                changes.insert_or_assign(paramId, value);
+                includeEngine = includeEngine || structuralParamIds.count(paramId) > 0;
             }
         }
     }
 
+    // Next we check the flag to identify if we should initialize the Elementary runtime
+    // and engine. All of that happens on the engine thread, in order: build the runtime,
+    // point the engine at it, render our complete state into it, and only then hand it
+    // to the real-time thread, which keeps running the previous runtime until then.
+    //
+    // Otherwise, however many parameter changes arrived since we last looked go out as
+    // one delta. Parameter values reach the graph natively through `param` nodes, so
+    // that delta is only for the editor unless it touches a structural parameter.
+    if (shouldInitialize.exchange(false)) {
+        auto const sampleRate = lastKnownSampleRate.load();
+
+        postToEngine([this, sampleRate]() {
+            createRuntime(sampleRate);
+        });
+
+        dispatchStateChange(true);
+
+        postToEngine([this]() {
+            if (nextRuntime != nullptr)
+                publishRuntime(std::move(nextRuntime));
+        });
+    } else {
+        dispatchStateChange(changes, includeEngine);
+    }
+
+    freeRetiredRuntimes();
+}
+
+bool EffectsPluginProcessor::waitForEngine(int timeoutMs)
+{
+    return engineThread.waitUntilIdle(timeoutMs);
+}
+
+void EffectsPluginProcessor::reloadJavaScriptEngine()
+{
+    postToEngine([this]() {
+        initJavaScriptEngine();
+    });
+
     dispatchStateChange();
 }
 
-void EffectsPluginProcessor::initJavaScriptEngine()
+void EffectsPluginProcessor::resetRuntime()
+{
+    // Clearing the reverb tail means starting over with a fresh runtime, which
+    // we do the same way as for a change of sample rate
+    shouldInitialize.store(true);
+    triggerAsyncUpdate();
+}
+
+void EffectsPluginProcessor::timerCallback()
 {
-    jsContext = choc::javascript::createQuickJSContext();
+    freeRetiredRuntimes();
 
-    // Install some native interop functions in our JavaScript environment
-    jsContext.registerFunction("__postNativeMessage__", [this](choc::javascript::ArgumentList args) {
-        auto const batch = elem::js::parseJSON(args[0]->toString());
-        auto const rc = runtime->applyInstructions(batch);
+    // Let the editor know when we go idle or wake up, for diagnostics. This isn't part
+    // of our saved state, so it only ever goes out as a change.
+    auto const idleNow = isIdle.load(std::memory_order_relaxed);
+
+    if (idleNow != lastDispatchedIdle) {
+        lastDispatchedIdle = idleNow;
+        dispatchStateChange(elem::js::Object {{ "idle", elem::js::Value(idleNow) }}, false);
+    }
+
+    // While profiling, the editor gets a fresh breakdown every time we come through
+    // here. Otherwise we forget our last reading, so that the first one after turning
+    // it back on doesn't count the time in between.
+    if (profiler.isEnabled()) {
+        dispatchProfile();
+    } else {
+        lastProfileReadings.clear();
+        lastProfileTimeMs = 0;
+    }
+}
+
+void EffectsPluginProcessor::setFastMathEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled == fastMath)
+        return;
+
+    fastMath = shouldBeEnabled;
+    dispatchStateChange(elem::js::Object {{ "fastMath", elem::js::Value(fastMath) }}, true);
+}
+
+void EffectsPluginProcessor::setParallelProcessingEnabled(bool shouldBeEnabled)
+{
+    // Once we have the pipeline we hold on to it, even while it's turned off, since the
+    // audio thread may be part way through a block on it. Its workers sleep when idle.
+    if (shouldBeEnabled && pipelineOwner == nullptr)
+        pipelineOwner = StagePipeline::acquire();
+
+    parallelPipeline.store(shouldBeEnabled ? pipelineOwner.get() : nullptr, std::memory_order_release);
+}
+
+void EffectsPluginProcessor::setWholeBlockProcessing(int maxBlockSize)
+{
+    wholeBlockSize = std::max(0, maxBlockSize);
+    wholeBlockInputBuffer.setSize(kMaxChannels, std::max(1, wholeBlockSize));
+}
+
+void EffectsPluginProcessor::setProfilingEnabled(bool shouldBeEnabled)
+{
+    profiler.setEnabled(shouldBeEnabled);
+}
+
+void EffectsPluginProcessor::setTelemetryEnabled(bool shouldBeEnabled)
+{
+    // Whatever piled up while nobody was looking is stale by now
+    drainTelemetry();
+    telemetryEnabled.store(shouldBeEnabled, std::memory_order_relaxed);
+}
 
-        if (rc != elem::ReturnCode::Ok()) {
-            dispatchError("Runtime Error", elem::ReturnCode::describe(rc));
+EffectsPluginProcessor::TelemetrySummary EffectsPluginProcessor::drainTelemetry()
+{
+    TelemetrySummary summary;
+    std::array<double, TelemetryFrame::kMaxChannels> sumOfSquares {};
+    double wetSumOfSquares = 0;
+    uint32_t numWetChannels = 0;
+    uint64_t numSamples = 0;
+    uint64_t processNanos = 0;
+    uint64_t budgetNanos = 0;
+
+    const juce::AbstractFifo::ScopedRead scope (telemetryFifo, telemetryFifo.getNumReady());
+
+    scope.forEach([&](int index) {
+        auto const& frame = telemetryFrames[static_cast<size_t>(index)];
+        summary.numChannels = std::max(summary.numChannels, frame.numChannels);
+
+        for (size_t ch = 0; ch < frame.numChannels; ++ch) {
+            summary.peak[ch] = std::max(summary.peak[ch], frame.peak[ch]);
+            sumOfSquares[ch] += frame.sumOfSquares[ch];
         }
 
-        return choc::value::Value();
+        wetSumOfSquares += frame.wetSumOfSquares;
+        numWetChannels = std::max(numWetChannels, frame.numWetChannels);
+        numSamples += frame.numSamples;
+        processNanos += frame.processNanos;
+        budgetNanos += frame.budgetNanos;
+
+        if (frame.budgetNanos > 0)
+            summary.maxLoad = std::max(summary.maxLoad, static_cast<double>(frame.processNanos) / frame.budgetNanos);
+
+        summary.numBlocks += 1;
+        summary.numIdleBlocks += frame.idle ? 1 : 0;
     });
 
-    jsContext.registerFunction("__log__", [this](choc::javascript::ArgumentList args) {
-        const auto* kDispatchScript = R"script(
-(function() {
-  console.log(...JSON.parse(%));
-  return true;
-})();
-)script";
+    if (numSamples > 0) {
+        for (size_t ch = 0; ch < summary.numChannels; ++ch)
+            summary.rms[ch] = static_cast<float>(std::sqrt(sumOfSquares[ch] / static_cast<double>(numSamples)));
 
-        // Forward logs to the editor if it's available; then logs show up in one place.
-        //
-        // If not available, we fall back to std out.
-        if (auto* editor = static_cast<WebViewEditor*>(getActiveEditor())) {
-            auto v = choc::value::createEmptyArray();
+        // The wet network's energy is summed over however many of its channels were
+        // metered, which is one on a mono output. Idle blocks meter none, and count
+        // as silence.
+        if (numWetChannels > 0)
+            summary.wetRms = static_cast<float>(std::sqrt(wetSumOfSquares / (numWetChannels * static_cast<double>(numSamples))));
+    }
 
-            for (size_t i = 0; i < args.numArgs; ++i) {
-                v.addArrayElement(*args[i]);
-            }
+    if (budgetNanos > 0)
+        summary.load = static_cast<double>(processNanos) / static_cast<double>(budgetNanos);
 
-            auto expr = juce::String(kDispatchScript).replace("%", elem::js::serialize(choc::json::toString(v))).toStdString();
-            editor->getWebViewPtr()->evaluateJavascript(expr);
-        } else {
-            for (size_t i = 0; i < args.numArgs; ++i) {
-                DBG(choc::json::toString(*args[i]));
+    // With no blocks to go by, the meters still show as many channels, at silence
+    if (summary.numChannels == 0)
+        summary.numChannels = static_cast<uint32_t>(juce::jlimit(1, static_cast<int>(TelemetryFrame::kMaxChannels), lastKnownNumChannels.load()));
+
+    summary.numOverruns = numOverruns.load(std::memory_order_relaxed);
+    summary.numDroppedFrames = numDroppedFrames.load(std::memory_order_relaxed);
+
+    return summary;
+}
+
+void EffectsPluginProcessor::dispatchProfile()
+{
+    auto readings = profiler.read();
+    auto const nowMs = juce::Time::getMillisecondCounterHiRes();
+    auto const elapsedNs = (nowMs - lastProfileTimeMs) * 1.0e6;
+    auto const hasBaseline = lastProfileTimeMs > 0 && elapsedNs > 0;
+
+    auto previous = std::move(lastProfileReadings);
+    lastProfileReadings = readings;
+    lastProfileTimeMs = nowMs;
+
+    if (!hasBaseline)
+        return;
+
+    // Entries are only ever added on the end, so they line up with the previous
+    // reading by index. Loads are a fraction of the real time that went by, where
+    // 1 would be a whole core.
+    auto entries = choc::value::createEmptyArray();
+    std::map<std::string, double> groupLoads;
+    double runtimeLoad = 0;
+    double nodesLoad = 0;
+
+    for (size_t i = 0; i < readings.size(); ++i) {
+        auto const& r = readings[i];
+        auto const nanos = r.nanos - (i < previous.size() ? previous[i].nanos : 0);
+        auto const calls = r.calls - (i < previous.size() ? previous[i].calls : 0);
+
+        if (calls == 0)
+            continue;
+
+        auto const load = static_cast<double>(nanos) / elapsedNs;
+
+        if (r.name == "runtime") {
+            runtimeLoad = load;
+            continue;
+        }
+
+        entries.addArrayElement(choc::value::createObject("",
+            "name", r.name,
+            "load", load,
+            "nsPerCall", static_cast<double>(nanos) / static_cast<double>(calls)));
+
+        // Stages are already part of the node they belong to
+        if (r.name.find('/') == std::string::npos) {
+            groupLoads[NodeProfiler::groupOf(r.name)] += load;
+            nodesLoad += load;
+        }
+    }
+
+    // Whatever the runtime spent outside of our own nodes went to Elementary's
+    // built-in ones
+    groupLoads["elementary"] += std::max(0.0, runtimeLoad - nodesLoad);
+
+    auto groups = choc::value::createEmptyArray();
+
+    for (auto const& [name, load] : groupLoads)
+        groups.addArrayElement(choc::value::createObject("", "name", name, "load", load));
+
+    auto const payload = choc::value::createObject("",
+        "elapsedMs", elapsedNs / 1.0e6,
+        "load", runtimeLoad,
+        "groups", groups,
+        "entries", entries);
+
+    editorBus.postProfile(payload);
+}
+
+void EffectsPluginProcessor::publishRuntime(std::unique_ptr<elem::Runtime<float>> next)
+{
+    // If the real-time thread never picked up the previously published runtime, it
+    // never will, and it's ours to delete
+    delete pendingRuntime.exchange(next.release(), std::memory_order_acq_rel);
+}
+
+void EffectsPluginProcessor::postToEngine(std::function<void()> job)
+{
+    engineThread.post([this, job = std::move(job)]() {
+        // A script error mustn't take the engine thread down with it
+        try {
+            job();
+        } catch (std::exception const& e) {
+            dispatchError("JavaScript Error", e.what());
+        }
+    });
+}
+
+void EffectsPluginProcessor::createRuntime(double sampleRate)
+{
+    // The new runtime stays private to the engine thread until the engine has
+    // rendered into it
+    nextRuntime = std::make_unique<elem::Runtime<float>>(sampleRate, wholeBlockSize > 0 ? wholeBlockSize : kRuntimeBlockSize);
+    runtime = nextRuntime.get();
+
+    // Register our native node types before the engine renders anything. Each one
+    // reports to the profiler, which costs next to nothing until it's turned on.
+    runtime->registerNodeType("srvb", [this](elem::NodeId const id, double fs, int const bs) {
+        return std::make_shared<ProfiledNode<float, SRVBNode<float>>>(profiler, "srvb", id, fs, bs, &profiler, &blockTelemetry, &blockPipeline);
+    });
+
+    runtime->registerNodeType("param", [this](elem::NodeId const id, double fs, int const bs) {
+        return std::make_shared<ProfiledNode<float, ParamNode<float>>>(profiler, "param", id, fs, bs);
+    });
+
+    runtime->registerNodeType("fused", [this](elem::NodeId const id, double fs, int const bs) {
+        return std::make_shared<ProfiledNode<float, FusedElementwiseNode<float>>>(profiler, "fused", id, fs, bs);
+    });
+
+    // The fusion pass mirrors the runtime's graph, so it starts over with it
+    graphFusion.reset();
+
+    // An engine that's already loaded only has to forget the graph it rendered into
+    // the old runtime. Everything else it holds carries over, and the full state
+    // dispatch that follows renders the whole graph into the new one.
+    if (hasRuntimeResetHandler) {
+        jsContext.invoke("__receiveRuntimeReset__");
+        return;
+    }
+
+    initJavaScriptEngine();
+}
+
+choc::value::Value EffectsPluginProcessor::applyInstructionBatch(elem::js::Array const& instructions)
+{
+    // Fuse chains of elementwise arithmetic before the batch reaches the runtime
+    auto const batch = graphFusion.process(instructions);
+    auto const rc = runtime->applyInstructions(batch);
+
+    if (rc != elem::ReturnCode::Ok()) {
+        dispatchError("Runtime Error", elem::ReturnCode::describe(rc));
+    }
+
+    lastRenderTimings.renderToApplyMs = juce::Time::getMillisecondCounterHiRes() - renderStartTime;
+
+    // Report back to the renderer what the fusion pass did, for its render stats
+    return choc::value::createObject("",
+        "nodesFused", static_cast<int64_t>(graphFusion.getNumFusedNodes()),
+        "fusedKernels", static_cast<int64_t>(graphFusion.getNumFusedKernels()));
+}
+
+void EffectsPluginProcessor::setInstructionTransport(InstructionTransport transport)
+{
+    postToEngine([this, transport]() {
+        instructionTransport = transport;
+    });
+}
+
+EffectsPluginProcessor::RenderTimings EffectsPluginProcessor::getLastRenderTimings()
+{
+    waitForEngine();
+    return lastRenderTimings;
+}
+
+void EffectsPluginProcessor::freeRetiredRuntimes()
+{
+    while (retiredRuntimesFifo.getNumReady() > 0) {
+        const juce::AbstractFifo::ScopedRead scope (retiredRuntimesFifo, 1);
+        delete retiredRuntimes[static_cast<size_t>(scope.startIndex1)];
+    }
+}
+
+void EffectsPluginProcessor::initJavaScriptEngine()
+{
+    // QuickJS ties each context to the stack of the thread that creates it, which is
+    // one more reason that contexts only ever come into being here, on the engine thread
+    jsContext.create();
+
+    hasStateChangeHandler = false;
+    hasErrorHandler = false;
+    hasRuntimeResetHandler = false;
+
+    // Install some native interop functions in our JavaScript environment
+    // Instruction batches arrive either as JSON, or, where we offer it, in the binary
+    // encoding from dsp/batch.js, which skips building and parsing all that text
+    jsContext.registerFunction("__postNativeMessage__", [this](choc::javascript::ArgumentList args) {
+        auto const json = args[0]->toString();
+        lastRenderTimings.batchBytes = json.size();
+
+        return applyInstructionBatch(elem::js::parseJSON(json));
+    });
+
+    if (instructionTransport == InstructionTransport::Binary) {
+        jsContext.registerBinaryFunction("__postNativeBatch__", [this](uint8_t const* data, size_t size) {
+            elem::js::Array batch;
+            lastRenderTimings.batchBytes = size;
+
+            if (!decodeInstructionBatch(data, size, batch)) {
+                dispatchError("Runtime Error", "Malformed instruction batch");
+                return choc::value::Value();
             }
+
+            return applyInstructionBatch(batch);
+        });
+    }
+
+    jsContext.registerFunction("__log__", [this](choc::javascript::ArgumentList args) {
+        // Forward logs to the editor so that they show up in one place. They go out
+        // with the editor's next frame, up to a limit per frame, and are dropped if
+        // no editor is open.
+        //
+        // Debug builds also write them to std out.
+        auto v = choc::value::createEmptyArray();
+
+        for (size_t i = 0; i < args.numArgs; ++i) {
+            v.addArrayElement(*args[i]);
+            DBG(choc::json::toString(*args[i]));
         }
 
+        editorBus.postLog(v);
+
         return choc::value::Value();
     });
 
@@ -316,14 +951,25 @@ void EffectsPluginProcessor::initJavaScriptEngine()
     auto dspEntryFile = juce::URL("http://localhost:5173/dsp.main.js");
     auto dspEntryFileContents = dspEntryFile.readEntireTextStream().toStdString();
 #else
-    auto dspEntryFile = getAssetsDirectory().getChildFile("dsp.main.js");
+    auto dspEntryFileContents = AssetCache::get(getAssetsDirectory())->getText("dsp.main.js");
 
-    if (!dspEntryFile.existsAsFile())
+    if (dspEntryFileContents.empty())
         return;
-
-    auto dspEntryFileContents = dspEntryFile.loadFileAsString().toStdString();
 #endif
-    jsContext.evaluate(dspEntryFileContents);
+
+    // Every instance, and every change of sample rate or block size, loads the same
+    // bundle, so we load it from cached bytecode whenever we can
+    jsContext.evaluate(dspEntryFileContents, "dsp.main.js", bytecodeCache);
+
+    // Look up the engine's handlers once, so that every dispatch from here on is a
+    // direct call rather than a script for QuickJS to parse and compile
+    const auto isFunction = [this](std::string const& name) {
+        return jsContext.evaluate("typeof globalThis." + name + " === 'function'").getWithDefault<bool>(false);
+    };
+
+    hasStateChangeHandler = isFunction("__receiveStateChange__");
+    hasErrorHandler = isFunction("__receiveError__");
+    hasRuntimeResetHandler = isFunction("__receiveRuntimeReset__");
 
     // Re-hydrate from current state
     const auto* kHydrateScript = R"script(
@@ -340,64 +986,52 @@ void EffectsPluginProcessor::initJavaScriptEngine()
     jsContext.evaluate(expr);
 }
 
-void EffectsPluginProcessor::dispatchStateChange()
+void EffectsPluginProcessor::dispatchStateChange(bool includeEngine)
 {
-    const auto* kDispatchScript = R"script(
-(function() {
-  if (typeof globalThis.__receiveStateChange__ !== 'function')
-    return false;
-
-  globalThis.__receiveStateChange__(%);
-  return true;
-})();
-)script";
-
-    // Need the double serialize here to correctly form the string script. The first
-    // serialize produces the payload we want, the second serialize ensures we can replace
-    // the % character in the above block and produce a valid javascript expression.
     auto localState = state;
-    localState.insert_or_assign("sampleRate", lastKnownSampleRate);
+    localState.insert_or_assign("sampleRate", lastKnownSampleRate.load());
+    localState.insert_or_assign("channels", elem::js::Number(lastKnownNumChannels.load()));
+    localState.insert_or_assign("fastMath", elem::js::Boolean(fastMath));
 
-    auto expr = juce::String(kDispatchScript).replace("%", elem::js::serialize(elem::js::serialize(localState))).toStdString();
-
-    // First we try to dispatch to the UI if it's available, because running this step will
-    // just involve placing a message in a queue.
-    if (auto* editor = static_cast<WebViewEditor*>(getActiveEditor())) {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
-    }
-
-    // Next we dispatch to the local engine which will evaluate any necessary JavaScript synchronously
-    // here on the main thread
-    jsContext.evaluate(expr);
+    dispatchStateChange(localState, includeEngine);
 }
 
-void EffectsPluginProcessor::dispatchError(std::string const& name, std::string const& message)
+void EffectsPluginProcessor::dispatchStateChange(elem::js::Object const& changes, bool includeEngine)
 {
-    const auto* kDispatchScript = R"script(
-(function() {
-  if (typeof globalThis.__receiveError__ !== 'function')
-    return false;
+    if (changes.empty())
+        return;
 
-  let e = new Error(%);
-  e.name = @;
+    auto const payload = toChocValue(changes);
 
-  globalThis.__receiveError__(e);
-  return true;
-})();
-)script";
+    // First the editor, if one's open, which gets these merged with any other changes
+    // since its last frame
+    editorBus.postStateChange(payload);
 
-    // Need the serialize here to correctly form the string script.
-    auto expr = juce::String(kDispatchScript).replace("@", elem::js::serialize(name)).replace("%", elem::js::serialize(message)).toStdString();
-
-    // First we try to dispatch to the UI if it's available, because running this step will
-    // just involve placing a message in a queue.
-    if (auto* editor = static_cast<WebViewEditor*>(getActiveEditor())) {
-        editor->getWebViewPtr()->evaluateJavascript(expr);
+    // Next we queue a direct call into the local engine, which runs on the engine thread
+    if (includeEngine) {
+        postToEngine([this, payload]() {
+            if (hasStateChangeHandler) {
+                renderStartTime = juce::Time::getMillisecondCounterHiRes();
+                jsContext.invoke("__receiveStateChange__", payload);
+            }
+        });
     }
+}
 
-    // Next we dispatch to the local engine which will evaluate any necessary JavaScript synchronously
-    // here on the main thread
-    jsContext.evaluate(expr);
+void EffectsPluginProcessor::dispatchError(std::string const& name, std::string const& message)
+{
+    // First we queue the error up for the editor's next frame
+    editorBus.postError(name, message);
+
+    // Next we call straight into the local engine, here on the engine thread. If its error
+    // handler throws too, there's nobody left to tell.
+    if (hasErrorHandler) {
+        try {
+            jsContext.invoke("__receiveError__", choc::value::createObject("",
+                "name", name,
+                "message", message));
+        } catch (std::exception const&) {}
+    }
 }
 
 //==============================================================================
@@ -420,6 +1054,18 @@ void EffectsPluginProcessor::setStateInformation (const void* data, int sizeInBy
                 state.insert_or_assign(i.first, i.second);
             }
         }
+
+        // Parameter values reach the graph through `param` nodes, which read them from
+        // the host's parameters rather than from our state, so restored values go back
+        // through the host path, as if the host had set them
+        for (auto* p : getParameters()) {
+            if (auto* pf = dynamic_cast<juce::AudioParameterFloat*>(p)) {
+                auto it = o.find(pf->paramID.toStdString());
+
+                if (it != o.end() && it->second.isNumber())
+                    pf->setValueNotifyingHost(pf->convertTo0to1(static_cast<float>(it->second.getNumber())));
+            }
+        }
     } catch(...) {
         // Failed to parse the incoming state, or the state we did parse was not actually
         // an object type. How you handle it is up to you, here we just ignore it
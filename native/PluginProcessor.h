@@ -3,15 +3,40 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
 #include <choc_javascript.h>
 #include <elem/Runtime.h>
 
+#include "EngineContext.h"
+#include "EngineThread.h"
+#include "GraphFusion.h"
+#include "MessageBus.h"
+#include "NodeProfiler.h"
+#include "ParamNode.h"
+#include "StagePipeline.h"
+#include "Telemetry.h"
+
+
+//==============================================================================
+/** Locates the bundled static assets: manifest.json, dsp.main.js and the editor. */
+juce::File getAssetsDirectory();
+
+/** Overrides the assets location for tools that run outside of a plugin bundle. */
+void setAssetsDirectory(juce::File const& dir);
 
 //==============================================================================
 class EffectsPluginProcessor
     : public juce::AudioProcessor,
       public juce::AudioProcessorParameter::Listener,
-      private juce::AsyncUpdater
+      private juce::AsyncUpdater,
+      private juce::Timer
 {
 public:
     //==============================================================================
@@ -59,25 +84,247 @@ public:
     void handleAsyncUpdate() override;
 
     //==============================================================================
-    /** Internal helper for initializing the embedded JS engine. */
-    void initJavaScriptEngine();
+    /** Implement the Timer interface. */
+    void timerCallback() override;
 
-    /** Internal helper for propagating processor state changes. */
-    void dispatchStateChange();
-    void dispatchError(std::string const& name, std::string const& message);
+    //==============================================================================
+    /** Reloads the embedded JS engine against the current runtime, then sends it our state. */
+    void reloadJavaScriptEngine();
+
+    /** Starts over from silence with a fresh runtime, which the engine renders the whole
+        graph into again, e.g. between files in an offline render. Hosts call reset() on
+        every transport stop, which we leave alone, so this is only for our own tools.
+        Message thread only.
+    */
+    void resetRuntime();
+
+    /** Blocks until the engine thread has finished all the work queued so far, e.g. so
+        that headless tools can wait for a runtime to be ready before processing audio.
+    */
+    bool waitForEngine(int timeoutMs = -1);
+
+    /** How the engine hands instruction batches over. Takes effect when the engine next loads. */
+    enum class InstructionTransport { Json, Binary };
+    void setInstructionTransport(InstructionTransport transport);
+
+    /** Timings of the most recent render, waiting for the engine to finish any in progress. */
+    struct RenderTimings {
+        double renderToApplyMs = 0;
+        size_t batchBytes = 0;
+    };
+
+    RenderTimings getLastRenderTimings();
+
+    /** True for parameters the manifest marks structural, whose changes re-render the graph. */
+    bool isStructuralParameter(std::string const& paramId) const { return structuralParamIds.count(paramId) > 0; }
+
+    /** Turns fast math on or off: approximated modulators in the wet network, within
+        its own rounding noise of the precise path (see FastMath.h). Builds configured
+        with ELEM_FAST_MATH start with it on. Message thread only.
+    */
+    void setFastMathEnabled(bool shouldBeEnabled);
+    bool isFastMathEnabled() const { return fastMath; }
+
+    /** Turns parallel processing on or off: the wet network's stages running as a
+        pipeline across threads (see StagePipeline.h) while the host renders offline,
+        with output identical to running them on the audio thread alone. Real-time
+        blocks never wait on another thread. Has no effect on a single core. Builds
+        configured with ELEM_PARALLEL_PROCESSING start with it on. Message thread only.
+    */
+    void setParallelProcessingEnabled(bool shouldBeEnabled);
+    bool isParallelProcessingEnabled() const { return parallelPipeline.load(std::memory_order_relaxed) != nullptr; }
+
+    /** Runs each host block of up to maxBlockSize samples through the runtime whole,
+        from a copy of its input, as processBlock did before it took blocks in chunks,
+        with the runtime built for blocks that size. Only there for the benchmark to
+        compare the two paths; 0 turns it off. Must come before prepareToPlay.
+    */
+    void setWholeBlockProcessing(int maxBlockSize);
+
+    /** True while silent input and a fully decayed tail let processBlock skip the runtime. */
+    bool isIdleBypassed() const { return isIdle.load(std::memory_order_relaxed); }
+
+    /** Turns per-node CPU profiling on or off. While it's on, the editor gets a
+        breakdown of where the real-time thread spends its time with each timer
+        update. Safe from any thread.
+    */
+    void setProfilingEnabled(bool shouldBeEnabled);
+    bool isProfilingEnabled() const { return profiler.isEnabled(); }
+
+    /** The running totals behind that breakdown, e.g. for headless tools. */
+    std::vector<NodeProfiler::Reading> readProfile() const { return profiler.read(); }
+
+    /** Turns per-block telemetry on or off. The editor turns it on while it's open. */
+    void setTelemetryEnabled(bool shouldBeEnabled);
+
+    /** Telemetry coalesced over every block since the last call. Message thread only. */
+    struct TelemetrySummary {
+        // Per output channel, for the first numChannels
+        std::array<float, TelemetryFrame::kMaxChannels> peak {};
+        std::array<float, TelemetryFrame::kMaxChannels> rms {};
+        uint32_t numChannels = 0;
+        float wetRms = 0;
+
+        // Time spent in processBlock as a fraction of the real time the blocks covered,
+        // overall and for the worst block
+        double load = 0;
+        double maxLoad = 0;
+
+        uint64_t numBlocks = 0;
+        uint64_t numIdleBlocks = 0;
+
+        // Running totals of blocks that took longer than the real time they covered,
+        // whether or not telemetry was on, and of frames lost to a full FIFO
+        uint64_t numOverruns = 0;
+        uint64_t numDroppedFrames = 0;
+    };
+
+    TelemetrySummary drainTelemetry();
+
+    /** Internal helpers for propagating processor state changes to the editor and, optionally,
+        the engine. The first sends the complete state, the second only the given keys.
+        Message thread only.
+    */
+    void dispatchStateChange(bool includeEngine = true);
+    void dispatchStateChange(elem::js::Object const& changes, bool includeEngine);
+
+    /** The channel to and from the editor's WebView, which the editor flushes each frame. */
+    MessageBus& getEditorBus() { return editorBus; }
 
 private:
+    //==============================================================================
+    /** Queues a job for the engine thread, reporting any error it throws. */
+    void postToEngine(std::function<void()> job);
+
+    //==============================================================================
+    // Engine thread only
+    void createRuntime(double sampleRate);
+    void initJavaScriptEngine();
+    choc::value::Value applyInstructionBatch(elem::js::Array const& instructions);
+    void dispatchError(std::string const& name, std::string const& message);
+
+    //==============================================================================
+    /** Hands a fully rendered runtime over to the real-time thread. */
+    void publishRuntime(std::unique_ptr<elem::Runtime<float>> next);
+
+    /** Deletes runtimes which the real-time thread has finished with. */
+    void freeRetiredRuntimes();
+
+    /** Sends the editor the profile since the last time we looked. Message thread only. */
+    void dispatchProfile();
+
+    /** Counts overruns and publishes the block's telemetry. Real-time thread only. */
+    void finishBlock(juce::AudioBuffer<float> const& buffer, uint64_t startNanos, bool wasIdle);
+
     //==============================================================================
     std::atomic<bool> shouldInitialize { false };
-    double lastKnownSampleRate = 0;
-    int lastKnownBlockSize = 0;
+    std::atomic<double> lastKnownSampleRate { 0 };
+    std::atomic<int> lastKnownNumChannels { 2 };
 
     elem::js::Object state;
-    choc::javascript::Context jsContext;
 
-    juce::AudioBuffer<float> scratchBuffer;
+    // Parameters whose changes re-render the graph, marked "structural" in the manifest
+    std::set<std::string> structuralParamIds;
+
+    bool fastMath = ELEM_FAST_MATH;
+
+    // The pipeline we hand offline blocks to, held from the first time parallel
+    // processing is turned on. `blockPipeline` is the audio thread's pick for the
+    // current block, which our srvb nodes read.
+    std::shared_ptr<StagePipeline> pipelineOwner;
+    std::atomic<StagePipeline*> parallelPipeline { nullptr };
+    StagePipeline* blockPipeline = nullptr;
+
+    // Every profiled node holds on to the profiler, so it has to outlive all of our
+    // runtimes, and comes before them here. "runtime" times the whole graph, which
+    // leaves the difference to the nodes we can't wrap ourselves.
+    NodeProfiler profiler;
+    NodeProfiler::Entry* runtimeProfileEntry = profiler.acquire("runtime");
+
+    std::vector<NodeProfiler::Reading> lastProfileReadings;
+    double lastProfileTimeMs = 0;
+
+    // The same goes for the telemetry our nodes write into during each block. Frames
+    // then go out to the message thread through `telemetryFrames`, and are dropped,
+    // and counted, whenever the editor falls that far behind.
+    BlockTelemetry blockTelemetry;
+    std::atomic<bool> telemetryEnabled { false };
+
+    static constexpr int kTelemetryCapacity = 2048;
+    juce::AbstractFifo telemetryFifo { kTelemetryCapacity };
+    std::array<TelemetryFrame, kTelemetryCapacity> telemetryFrames {};
+
+    std::atomic<uint64_t> numOverruns { 0 };
+    std::atomic<uint64_t> numDroppedFrames { 0 };
+
+    // The embedded engine and everything it touches live on the engine thread. The
+    // message thread only ever queues work for it, and results come back through
+    // `pendingRuntime` below and the editor script queue. The thread itself may be
+    // shared with other instances, but our jobs always run on it one at a time.
+    EngineThread engineThread;
+
+    BytecodeCache bytecodeCache;
+    EngineContext jsContext;
+    GraphFusion graphFusion;
+
+    InstructionTransport instructionTransport = InstructionTransport::Binary;
+    double renderStartTime = 0;
+    RenderTimings lastRenderTimings;
+
+    // Whether the loaded engine defines each handler, resolved once per load
+    bool hasStateChangeHandler = false;
+    bool hasErrorHandler = false;
+    bool hasRuntimeResetHandler = false;
+
+    // Everything bound for the editor goes through here, and out once per frame
+    MessageBus editorBus;
+
+    // Runtimes always run blocks of up to kRuntimeBlockSize, and processBlock feeds
+    // longer host blocks through in chunks, so that a new host block size never
+    // means a new runtime
+    static constexpr int kRuntimeBlockSize = 512;
+    static constexpr int kMaxChannels = 32;
+
+    // Allocated once, up front, since prepareToPlay can come at any time, including
+    // while processBlock is reading from it
+    juce::AudioBuffer<float> chunkInputBuffer { kMaxChannels, kRuntimeBlockSize };
+    std::array<float const*, kMaxChannels> chunkInputs {};
+    std::array<float*, kMaxChannels> chunkOutputs {};
+
+    // The whole-block path the benchmark compares against, off unless it's given a size
+    int wholeBlockSize = 0;
+    juce::AudioBuffer<float> wholeBlockInputBuffer;
+
+    // The runtime is built and rendered on the engine thread, then published through
+    // `pendingRuntime`. The real-time thread swaps it in at the next block boundary
+    // and passes the instance it replaced back through `retiredRuntimes`, from which
+    // the main thread deletes it. Neither side ever waits on the other.
+    //
+    // `runtime` always points at the newest instance, which is the one the engine
+    // renders into, and is only touched on the engine thread, as is `nextRuntime`,
+    // which owns a runtime until it's published.
+    elem::Runtime<float>* runtime = nullptr;
+    std::unique_ptr<elem::Runtime<float>> nextRuntime;
+    std::atomic<elem::Runtime<float>*> pendingRuntime { nullptr };
+    elem::Runtime<float>* audioRuntime = nullptr;
+
+    static constexpr int kMaxRetiredRuntimes = 8;
+    juce::AbstractFifo retiredRuntimesFifo { kMaxRetiredRuntimes };
+    std::array<elem::Runtime<float>*, kMaxRetiredRuntimes> retiredRuntimes {};
+
+    static_assert(std::atomic<elem::Runtime<float>*>::is_always_lock_free);
+
+    ParameterBlock parameterBlock;
+
+    // Idle bypass. Below kIdleThreshold (-100dBFS) counts as silence, and we hold on
+    // for longer than the longest trip through the network before trusting it.
+    static constexpr float kIdleThreshold = 1.0e-5f;
+    static constexpr double kIdleHoldSeconds = 1.0;
 
-    std::unique_ptr<elem::Runtime<float>> runtime;
+    bool idle = false;
+    juce::int64 numSilentSamples = 0;
+    std::atomic<bool> isIdle { false };
+    bool lastDispatchedIdle = false;
 
     //==============================================================================
     // A simple "dirty list" abstraction here for propagating realtime parameter
@@ -0,0 +1,355 @@
+#include "RealtimeSanitizer.h"
+
+#if ! (defined(__linux__) && defined(__GLIBC__))
+ #error "The realtime sanitizer relies on glibc symbol interposition, and only builds on Linux."
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+//==============================================================================
+// glibc's own entry points to its allocator, which we forward to without going
+// through dlsym, since dlsym itself allocates
+extern "C" {
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+}
+
+namespace
+{
+    //==============================================================================
+    // How deep the calling thread is in ScopedRealtime, and in ScopedDisable. Both
+    // are constant-initialized, so touching them never allocates.
+    thread_local int realtimeDepth = 0;
+    thread_local int disabledDepth = 0;
+
+    std::atomic<bool> abortOnViolation { false };
+    std::atomic<uint64_t> numViolations { 0 };
+
+    constexpr int kMaxFrames = 32;
+    constexpr size_t kMaxRecords = 256;
+
+    struct Record {
+        char const* what = nullptr;
+        std::array<void*, kMaxFrames> frames {};
+        int numFrames = 0;
+    };
+
+    std::array<Record, kMaxRecords> records;
+    std::atomic<size_t> numRecords { 0 };
+
+    //==============================================================================
+    void writeString(char const* s)
+    {
+        // Straight to the system call, which we don't intercept
+        auto const unused = ::syscall(SYS_write, STDERR_FILENO, s, std::strlen(s));
+        (void) unused;
+    }
+
+    void reportViolation(char const* what)
+    {
+        // Everything from here on happens with checks off, so that nothing we do to
+        // report a violation reports another
+        RealtimeSanitizer::ScopedDisable disable;
+
+        numViolations.fetch_add(1, std::memory_order_relaxed);
+
+        void* frames[kMaxFrames];
+        auto const numFrames = backtrace(frames, kMaxFrames);
+
+        if (abortOnViolation.load(std::memory_order_relaxed)) {
+            writeString("Realtime violation: ");
+            writeString(what);
+            writeString("\n");
+            backtrace_symbols_fd(frames, numFrames, STDERR_FILENO);
+            std::abort();
+        }
+
+        auto const index = numRecords.fetch_add(1, std::memory_order_relaxed);
+
+        if (index >= kMaxRecords)
+            return;
+
+        auto& r = records[index];
+        r.what = what;
+        r.numFrames = numFrames;
+        std::copy_n(frames, numFrames, r.frames.begin());
+    }
+
+    inline void check(char const* what)
+    {
+        if (realtimeDepth > 0 && disabledDepth == 0)
+            reportViolation(what);
+    }
+
+    //==============================================================================
+    // Everything else we forward to through dlsym, resolved once on first use
+    template <typename Fn>
+    Fn resolve(char const* name)
+    {
+        RealtimeSanitizer::ScopedDisable disable;
+        return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+    }
+
+    // The condition variable functions come in two versions, and plain dlsym gives
+    // us the old one
+    template <typename Fn>
+    Fn resolveVersion(char const* name, char const* version)
+    {
+        RealtimeSanitizer::ScopedDisable disable;
+        return reinterpret_cast<Fn>(dlvsym(RTLD_NEXT, name, version));
+    }
+
+    #define ELEM_RTSAN_REAL(name) \
+        static auto const real = resolve<decltype(&::name)>(#name)
+
+    #define ELEM_RTSAN_REAL_VERSION(name, version) \
+        static auto const real = resolveVersion<decltype(&::name)>(#name, version)
+
+    // The first backtrace() loads the unwinder, which allocates, so we get that out
+    // of the way before anyone needs a stack. We pick up ELEM_RT_SANITIZER=abort
+    // from the environment here too.
+    struct Primer {
+        Primer() {
+            void* frames[1];
+            backtrace(frames, 1);
+
+            if (auto const* mode = std::getenv("ELEM_RT_SANITIZER"); mode != nullptr && std::strcmp(mode, "abort") == 0)
+                abortOnViolation.store(true, std::memory_order_relaxed);
+        }
+    } const primer;
+}
+
+//==============================================================================
+RealtimeSanitizer::ScopedRealtime::ScopedRealtime() { ++realtimeDepth; }
+RealtimeSanitizer::ScopedRealtime::~ScopedRealtime() { --realtimeDepth; }
+
+RealtimeSanitizer::ScopedDisable::ScopedDisable() { ++disabledDepth; }
+RealtimeSanitizer::ScopedDisable::~ScopedDisable() { --disabledDepth; }
+
+void RealtimeSanitizer::setAbortOnViolation (bool shouldAbort)
+{
+    abortOnViolation.store(shouldAbort, std::memory_order_relaxed);
+}
+
+uint64_t RealtimeSanitizer::getNumViolations()
+{
+    return numViolations.load(std::memory_order_relaxed);
+}
+
+size_t RealtimeSanitizer::printReport (std::ostream& out)
+{
+    ScopedDisable disable;
+
+    // The same call site tends to violate on every block, so we only print each
+    // distinct stack once, with how many times we saw it
+    std::vector<std::pair<std::vector<void*>, size_t>> distinct;
+    std::vector<char const*> whats;
+
+    auto const n = std::min(numRecords.load(std::memory_order_acquire), kMaxRecords);
+
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<void*> stack(records[i].frames.begin(), records[i].frames.begin() + records[i].numFrames);
+        bool seen = false;
+
+        for (auto& [s, count] : distinct) {
+            if (s == stack) {
+                ++count;
+                seen = true;
+                break;
+            }
+        }
+
+        if (!seen) {
+            distinct.emplace_back(std::move(stack), 1);
+            whats.push_back(records[i].what);
+        }
+    }
+
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        auto const& [stack, count] = distinct[i];
+        out << "Realtime violation: " << whats[i] << " (" << count << "x)\n";
+
+        if (auto** symbols = backtrace_symbols(stack.data(), static_cast<int>(stack.size()))) {
+            for (size_t f = 0; f < stack.size(); ++f)
+                out << "    " << symbols[f] << "\n";
+
+            std::free(symbols);
+        }
+    }
+
+    if (numRecords.load() > kMaxRecords)
+        out << "... and " << (numRecords.load() - kMaxRecords) << " more that we had no room to record\n";
+
+    return distinct.size();
+}
+
+void RealtimeSanitizer::clear()
+{
+    numRecords.store(0);
+    numViolations.store(0);
+}
+
+//==============================================================================
+// The interposed functions themselves
+extern "C" {
+
+void* malloc (size_t size) noexcept
+{
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc (size_t n, size_t size) noexcept
+{
+    check("calloc");
+    return __libc_calloc(n, size);
+}
+
+void* realloc (void* ptr, size_t size) noexcept
+{
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        check("free");
+
+    __libc_free(ptr);
+}
+
+void* memalign (size_t alignment, size_t size) noexcept
+{
+    check("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc (size_t alignment, size_t size) noexcept
+{
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign (void** ptr, size_t alignment, size_t size) noexcept
+{
+    check("posix_memalign");
+
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    *ptr = __libc_memalign(alignment, size);
+    return (*ptr == nullptr && size > 0) ? ENOMEM : 0;
+}
+
+int pthread_mutex_lock (pthread_mutex_t* m) noexcept
+{
+    check("pthread_mutex_lock");
+    ELEM_RTSAN_REAL(pthread_mutex_lock);
+    return real(m);
+}
+
+int pthread_rwlock_rdlock (pthread_rwlock_t* l) noexcept
+{
+    check("pthread_rwlock_rdlock");
+    ELEM_RTSAN_REAL(pthread_rwlock_rdlock);
+    return real(l);
+}
+
+int pthread_rwlock_wrlock (pthread_rwlock_t* l) noexcept
+{
+    check("pthread_rwlock_wrlock");
+    ELEM_RTSAN_REAL(pthread_rwlock_wrlock);
+    return real(l);
+}
+
+int pthread_cond_wait (pthread_cond_t* c, pthread_mutex_t* m)
+{
+    check("pthread_cond_wait");
+    ELEM_RTSAN_REAL_VERSION(pthread_cond_wait, "GLIBC_2.3.2");
+    return real(c, m);
+}
+
+int pthread_cond_timedwait (pthread_cond_t* c, pthread_mutex_t* m, timespec const* t)
+{
+    check("pthread_cond_timedwait");
+    ELEM_RTSAN_REAL_VERSION(pthread_cond_timedwait, "GLIBC_2.3.2");
+    return real(c, m, t);
+}
+
+int sem_wait (sem_t* s)
+{
+    check("sem_wait");
+    ELEM_RTSAN_REAL(sem_wait);
+    return real(s);
+}
+
+int nanosleep (timespec const* req, timespec* rem)
+{
+    check("nanosleep");
+    ELEM_RTSAN_REAL(nanosleep);
+    return real(req, rem);
+}
+
+int usleep (useconds_t usec)
+{
+    check("usleep");
+    ELEM_RTSAN_REAL(usleep);
+    return real(usec);
+}
+
+unsigned int sleep (unsigned int seconds)
+{
+    check("sleep");
+    ELEM_RTSAN_REAL(sleep);
+    return real(seconds);
+}
+
+ssize_t read (int fd, void* buf, size_t count)
+{
+    check("read");
+    ELEM_RTSAN_REAL(read);
+    return real(fd, buf, count);
+}
+
+ssize_t write (int fd, void const* buf, size_t count)
+{
+    check("write");
+    ELEM_RTSAN_REAL(write);
+    return real(fd, buf, count);
+}
+
+int poll (pollfd* fds, nfds_t n, int timeout)
+{
+    check("poll");
+    ELEM_RTSAN_REAL(poll);
+    return real(fds, n, timeout);
+}
+
+int select (int n, fd_set* r, fd_set* w, fd_set* e, timeval* timeout)
+{
+    check("select");
+    ELEM_RTSAN_REAL(select);
+    return real(n, r, w, e, timeout);
+}
+
+}
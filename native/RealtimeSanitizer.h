@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+
+//==============================================================================
+// Catches the audio thread doing things it mustn't: allocating or freeing heap
+// memory, taking a mutex, or making a blocking system call.
+//
+// Only built into the headless tools, with ELEM_RT_SANITIZER (see CMakeLists.txt),
+// where we can interpose the C library's functions from the executable itself. Each
+// interposed function checks whether its thread is inside a ScopedRealtime, as
+// processBlock is for its whole duration, and reports a violation if so.
+//
+// Reporting never allocates or blocks itself. By default a violation is recorded,
+// with its stack, into a fixed table for printReport() to symbolize later; with
+// setAbortOnViolation(true), or ELEM_RT_SANITIZER=abort in the environment, it
+// writes the stack to stderr and aborts on the spot.
+//
+// Linux with glibc only.
+class RealtimeSanitizer
+{
+public:
+    /** Marks the calling thread as real-time for as long as it's in scope. Nests. */
+    struct ScopedRealtime
+    {
+        ScopedRealtime();
+        ~ScopedRealtime();
+    };
+
+    /** Lets the calling thread do as it pleases for as long as it's in scope, e.g. for
+        work that we know about and have accepted, like deliberately logging.
+    */
+    struct ScopedDisable
+    {
+        ScopedDisable();
+        ~ScopedDisable();
+    };
+
+    //==============================================================================
+    static void setAbortOnViolation (bool shouldAbort);
+
+    /** The number of violations so far, including any the table had no room to record. */
+    static uint64_t getNumViolations();
+
+    /** Writes every distinct violation recorded so far, with its stack, and returns how
+        many there were. Not for the audio thread.
+    */
+    static size_t printReport (std::ostream& out);
+
+    /** Forgets everything recorded so far. Not for use while any thread is in a ScopedRealtime. */
+    static void clear();
+};
@@ -0,0 +1,251 @@
+#include "PluginProcessor.h"
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+
+//==============================================================================
+// An offline batch renderer which runs files through EffectsPluginProcessor.
+//
+// Every worker thread owns a single processor, with its own embedded JavaScript
+// engine and runtime, and pulls files off a shared queue until the queue is empty.
+// Audio is streamed through the processor in fixed-size chunks, reading from a
+// memory-mapped file where the format supports it, so memory use doesn't grow
+// with file length.
+//
+// With --parallel, each processor may also run its wet network across threads,
+// through the one pipeline the whole process shares. That helps most with fewer
+// files than cores, such as one long file, where the workers alone leave cores idle;
+// whichever worker finds the pipeline busy simply runs its block by itself. The
+// output is the same either way.
+//
+// Usage:
+//   SRVBRender [--assets <dist dir>] [--out <dir>] [--jobs <n>] [--block <samples>]
+//              [--preset <file.json>] [--param <id>=<value> ...] [--tail <seconds>]
+//              [--bits <16|24|32>] [--parallel] <file or directory>...
+
+//==============================================================================
+struct RenderOptions
+{
+    juce::File outputDir;
+    std::map<juce::String, float> params;
+    int blockSize = 4096;
+    int bitsPerSample = 24;
+    double tailSeconds = 0;
+    bool parallel = false;
+};
+
+// Applies parameter values, given in their natural range, through the host path
+// so that the processor state and JavaScript engine both see them
+static void applyParameters(EffectsPluginProcessor& proc, std::map<juce::String, float> const& params)
+{
+    for (auto* p : proc.getParameters()) {
+        if (auto* pf = dynamic_cast<juce::AudioParameterFloat*>(p)) {
+            auto it = params.find(pf->paramID);
+
+            if (it != params.end())
+                pf->setValueNotifyingHost(pf->convertTo0to1(it->second));
+        }
+    }
+}
+
+static std::unique_ptr<juce::AudioFormatReader> createStreamingReader(juce::AudioFormatManager& formats, juce::File const& file)
+{
+    if (auto* format = formats.findFormatForFileExtension(file.getFileExtension())) {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+
+        if (mapped != nullptr && mapped->mapEntireFile())
+            return mapped;
+    }
+
+    return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+}
+
+static juce::String renderFile(EffectsPluginProcessor& proc, juce::AudioFormatManager& formats, juce::File const& input, juce::File const& output, RenderOptions const& options)
+{
+    auto reader = createStreamingReader(formats, input);
+
+    if (reader == nullptr)
+        return "unsupported or unreadable file";
+
+    auto const sampleRate = reader->sampleRate;
+    auto const blockSize = options.blockSize;
+
+    // Start every file from a clean processor: new sample rate if needed, no tail
+    // left over from the previous file, and the requested parameter values
+    proc.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+    proc.prepareToPlay(sampleRate, blockSize);
+    proc.resetRuntime();
+    applyParameters(proc, options.params);
+    proc.handleAsyncUpdate();
+    proc.waitForEngine();
+
+    output.getParentDirectory().createDirectory();
+    output.deleteFile();
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    if (auto stream = output.createOutputStream()) {
+        writer.reset(wav.createWriterFor(stream.get(), sampleRate, 2, options.bitsPerSample, {}, 0));
+
+        if (writer != nullptr)
+            stream.release();
+    }
+
+    if (writer == nullptr)
+        return "could not create " + output.getFullPathName();
+
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+
+    auto const numInputChannels = static_cast<int>(reader->numChannels);
+    auto const totalSamples = reader->lengthInSamples + static_cast<juce::int64>(options.tailSeconds * sampleRate);
+
+    for (juce::int64 pos = 0; pos < totalSamples; pos += blockSize) {
+        auto const n = static_cast<int>(std::min<juce::int64>(blockSize, totalSamples - pos));
+
+        buffer.setSize(2, n, false, false, true);
+        buffer.clear();
+
+        // Reads past the end of the input come back as silence, which gives us the tail
+        reader->read(&buffer, 0, n, pos, true, numInputChannels > 1);
+
+        if (numInputChannels == 1)
+            buffer.copyFrom(1, 0, buffer, 0, 0, n);
+
+        proc.processBlock(buffer, midi);
+
+        if (!writer->writeFromAudioSampleBuffer(buffer, 0, n))
+            return "write failed";
+    }
+
+    return {};
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    auto const cwd = juce::File::getCurrentWorkingDirectory();
+    auto const assetsDir = args.containsOption("--assets")
+        ? cwd.getChildFile(args.removeValueForOption("--assets"))
+        : juce::File(ELEM_TOOLS_ASSETS_DIR);
+
+    if (!assetsDir.getChildFile("manifest.json").existsAsFile() || !assetsDir.getChildFile("dsp.main.js").existsAsFile()) {
+        std::cerr << "Could not find manifest.json and dsp.main.js in " << assetsDir.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    setAssetsDirectory(assetsDir);
+
+    RenderOptions options;
+    options.outputDir = cwd.getChildFile(args.containsOption("--out") ? args.removeValueForOption("--out") : "srvb-out");
+
+    if (args.containsOption("--block"))
+        options.blockSize = juce::jlimit(16, 65536, args.removeValueForOption("--block").getIntValue());
+
+    if (args.containsOption("--bits"))
+        options.bitsPerSample = args.removeValueForOption("--bits").getIntValue();
+
+    if (args.containsOption("--tail"))
+        options.tailSeconds = juce::jmax(0.0, args.removeValueForOption("--tail").getDoubleValue());
+
+    options.parallel = args.removeOptionIfFound("--parallel");
+
+    auto numJobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    if (args.containsOption("--jobs"))
+        numJobs = juce::jmax(1, args.removeValueForOption("--jobs").getIntValue());
+
+    // Parameter values come from the manifest defaults, then the preset, then
+    // any explicit --param overrides
+    if (args.containsOption("--preset")) {
+        auto const preset = juce::JSON::parse(cwd.getChildFile(args.removeValueForOption("--preset")));
+
+        if (auto* obj = preset.getDynamicObject()) {
+            for (auto const& prop : obj->getProperties())
+                options.params[prop.name.toString()] = static_cast<float>(prop.value);
+        } else {
+            std::cerr << "Preset must be a JSON object of parameter values" << std::endl;
+            return 1;
+        }
+    }
+
+    while (args.containsOption("--param")) {
+        auto const kv = args.removeValueForOption("--param");
+        options.params[kv.upToFirstOccurrenceOf("=", false, false)] = kv.fromFirstOccurrenceOf("=", false, false).getFloatValue();
+    }
+
+    // Everything left over is an input file or directory
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::vector<std::pair<juce::File, juce::File>> jobs;
+
+    for (auto const& arg : args.arguments) {
+        auto const f = cwd.getChildFile(arg.text);
+
+        if (f.isDirectory()) {
+            for (auto const& entry : juce::RangedDirectoryIterator(f, true, formats.getWildcardForAllFormats(), juce::File::findFiles))
+                jobs.push_back({ entry.getFile(), options.outputDir.getChildFile(entry.getFile().getRelativePathFrom(f)).withFileExtension("wav") });
+        } else if (f.existsAsFile()) {
+            jobs.push_back({ f, options.outputDir.getChildFile(f.getFileNameWithoutExtension() + ".wav") });
+        } else {
+            std::cerr << "Skipping " << arg.text << ": not found" << std::endl;
+        }
+    }
+
+    if (jobs.empty()) {
+        std::cerr << "Nothing to render" << std::endl;
+        return 1;
+    }
+
+    std::atomic<size_t> nextJob { 0 };
+    std::atomic<int> numFailures { 0 };
+    std::mutex logLock;
+
+    auto const worker = [&]() {
+        // One processor, and one embedded engine, per worker for its whole lifetime
+        EffectsPluginProcessor proc;
+        proc.setNonRealtime(true);
+        proc.setParallelProcessingEnabled(options.parallel);
+
+        juce::AudioFormatManager workerFormats;
+        workerFormats.registerBasicFormats();
+
+        for (auto i = nextJob.fetch_add(1); i < jobs.size(); i = nextJob.fetch_add(1)) {
+            auto const& [input, output] = jobs[i];
+            auto const start = juce::Time::getMillisecondCounterHiRes();
+            auto const error = renderFile(proc, workerFormats, input, output, options);
+            auto const elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+            std::lock_guard<std::mutex> lock(logLock);
+
+            if (error.isNotEmpty()) {
+                numFailures++;
+                std::cerr << "[" << (i + 1) << "/" << jobs.size() << "] " << input.getFullPathName() << ": " << error << std::endl;
+            } else {
+                std::cerr << "[" << (i + 1) << "/" << jobs.size() << "] " << input.getFullPathName() << " -> " << output.getFullPathName()
+                          << " (" << juce::String(elapsed, 2) << "s)" << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < std::min<int>(numJobs, static_cast<int>(jobs.size())); ++i)
+        threads.emplace_back(worker);
+
+    for (auto& t : threads)
+        t.join();
+
+    return numFailures.load() > 0 ? 1 : 0;
+}
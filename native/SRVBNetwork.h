@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "FastMath.h"
+#include "Hadamard.h"
+#include "InterleavedDelay.h"
+#include "NodeProfiler.h"
+#include "StagePipeline.h"
+
+
+//==============================================================================
+// The interface SRVBNode drives its network through, whatever the line count.
+template <typename FloatType>
+struct SRVBNetworkBase
+{
+    enum Stage { Diffusion, Feedback, Downmix, NumStages };
+
+    // Up to 16 input and output channels, enough for a 9.1.6 bed
+    static constexpr size_t MaxChannels = 16;
+
+    using Inputs = std::array<FloatType const*, MaxChannels>;
+    using Outputs = std::array<FloatType*, MaxChannels>;
+
+    virtual ~SRVBNetworkBase() = default;
+
+    /** Runs the network over one block of up to the prepared block size, reading the first numChannels
+        inputs and adding its output into the first numChannels outputs.
+    */
+    virtual void process (FloatType const* size, FloatType const* decay, FloatType const* mod,
+                          Inputs const& ins, size_t numSamples, Outputs const& outs) = 0;
+
+    // While timeStages is set, process() adds the time it spends in each stage, in
+    // nanoseconds, to stageNanos for the owner to collect
+    bool timeStages = false;
+
+    // While fastMath is set, the delay modulators use fastSin2Pi() in place of std::sin
+    bool fastMath = false;
+    std::array<uint64_t, NumStages> stageNanos {};
+
+    // While pipeline is set, process() may hand large blocks to it to run the
+    // network's stages on several threads at once
+    StagePipeline* pipeline = nullptr;
+};
+
+//==============================================================================
+// The SRVB wet network, with NumLines lines.
+//
+// The input is upmixed to NumLines channels, run through three diffusion steps
+// and two damped feedback delay networks, and decoded back to as many channels as
+// came in. Each Hadamard mix is computed in place with hadamardInPlace(), and every
+// step works on whole blocks of per-line buffers rather than on individual samples
+// wherever the signal flow allows.
+//
+// More lines give a denser tail at a cost per sample that grows a little faster
+// than linearly with the line count. More channels share the same lines, and only
+// add to the cost of the upmix and decode, so a surround or immersive bed costs
+// far less through one network than through a stereo network per pair.
+template <typename FloatType, size_t NumLines>
+class SRVBNetwork : public SRVBNetworkBase<FloatType>
+{
+public:
+    static_assert(NumLines >= 4 && (NumLines & (NumLines - 1)) == 0, "SRVBNetwork needs a power-of-two line count of at least four");
+
+    using typename SRVBNetworkBase<FloatType>::Inputs;
+    using typename SRVBNetworkBase<FloatType>::Outputs;
+
+    /** Prepares the network to run at the given rate, in blocks of up to bs samples, with
+        numChannels inputs and outputs, which must be no more than NumLines.
+    */
+    SRVBNetwork (double sampleRate, size_t bs, size_t numChannels = 2)
+        : channels(std::clamp<size_t>(numChannels, 1, NumLines))
+    {
+        auto const ms2samps = [=](double ms) { return sampleRate * (ms / 1000.0); };
+
+        for (size_t i = 0; i < NumLines; ++i) {
+            lineData[i].assign(bs, FloatType(0));
+            lines[i] = lineData[i].data();
+        }
+
+        // Diffusion step sizes, in ms, and each line within a step is
+        // (i + 1) / NumLines of the step size
+        std::array<double, 3> const diffusionSizes {{ 43.0, 97.0, 117.0 }};
+
+        for (size_t s = 0; s < diffusers.size(); ++s) {
+            diffusers[s].prepare(ms2samps(diffusionSizes[s]));
+        }
+
+        // The first FDN runs with a fixed, very short decay, the second follows
+        // the decay parameter
+        constantDecay.assign(bs, FloatType(0.004));
+
+        for (auto& fdn : fdns) {
+            fdn.prepare(sampleRate, bs);
+        }
+    }
+
+    void process (FloatType const* size, FloatType const* decay, FloatType const* mod,
+                  Inputs const& ins, size_t numSamples, Outputs const& outs) override
+    {
+        // Large blocks go through the pipeline when we've been given one, unless
+        // we're timing the stages, or it's busy with another network's block
+        if (this->pipeline != nullptr && !this->timeStages && numSamples >= kMinPipelinedSamples) {
+            Pipelined job { *this, size, decay, mod, ins, outs };
+
+            if (this->pipeline->run(job, 3, numSamples, kPipelineChunkSize))
+                return;
+        }
+
+        auto const start = this->timeStages ? NodeProfiler::now() : 0;
+
+        diffuse(ins, 0, numSamples);
+
+        auto const diffused = this->timeStages ? NodeProfiler::now() : 0;
+
+        reverberate(0, size, constantDecay.data(), mod, 0, numSamples);
+        reverberate(1, size, decay, mod, 0, numSamples);
+
+        auto const reverberated = this->timeStages ? NodeProfiler::now() : 0;
+
+        mixDown(outs, 0, numSamples);
+
+        if (this->timeStages) {
+            this->stageNanos[this->Diffusion] += diffused - start;
+            this->stageNanos[this->Feedback] += reverberated - diffused;
+            this->stageNanos[this->Downmix] += NodeProfiler::now() - reverberated;
+        }
+    }
+
+private:
+    using Lines = std::array<FloatType*, NumLines>;
+
+    //==============================================================================
+    // The network as three stages over the samples [start, start + numSamples) of a
+    // block, each touching only its own state. Run one after the other over a whole
+    // block, or over a chunk at a time in a StagePipeline, they give the same result.
+    //
+    // The split follows the cost: the diffusion and either FDN each take about a
+    // third of the time, and the downmix next to nothing.
+    void diffuse (Inputs const& ins, size_t start, size_t numSamples)
+    {
+        auto const l = linesFrom(start);
+
+        if (channels == 2) {
+            upmixStereo(l, ins[0] + start, ins[1] + start, numSamples);
+        } else {
+            upmix(l, ins, start, numSamples);
+        }
+
+        for (auto& step : diffusers) {
+            step.process(l, numSamples);
+            hadamardInPlace<FloatType, NumLines>(l, numSamples);
+        }
+    }
+
+    void reverberate (size_t fdn, FloatType const* size, FloatType const* decay, FloatType const* mod, size_t start, size_t numSamples)
+    {
+        fdns[fdn].process(linesFrom(start), numSamples, size + start, decay + start, mod + start, this->fastMath);
+    }
+
+    void mixDown (Outputs const& outs, size_t start, size_t numSamples)
+    {
+        auto const l = linesFrom(start);
+
+        if (channels == 2) {
+            downmixStereo(l, outs[0] + start, outs[1] + start, numSamples);
+        } else {
+            decode(l, outs, start, numSamples);
+        }
+    }
+
+    Lines linesFrom (size_t start) const
+    {
+        Lines l;
+
+        for (size_t i = 0; i < NumLines; ++i)
+            l[i] = lines[i] + start;
+
+        return l;
+    }
+
+    // One block's worth of stages, for the pipeline to run a chunk at a time
+    struct Pipelined : StagePipeline::Job
+    {
+        Pipelined (SRVBNetwork& n, FloatType const* s, FloatType const* d, FloatType const* m, Inputs const& i, Outputs const& o)
+            : network(n), size(s), decay(d), mod(m), ins(i), outs(o) {}
+
+        void runStage (size_t stage, size_t start, size_t numSamples) override
+        {
+            switch (stage) {
+                case 0:
+                    network.diffuse(ins, start, numSamples);
+                    break;
+                case 1:
+                    network.reverberate(0, size, network.constantDecay.data(), mod, start, numSamples);
+                    break;
+                default:
+                    network.reverberate(1, size, decay, mod, start, numSamples);
+                    network.mixDown(outs, start, numSamples);
+                    break;
+            }
+        }
+
+        SRVBNetwork& network;
+        FloatType const* size;
+        FloatType const* decay;
+        FloatType const* mod;
+        Inputs const& ins;
+        Outputs const& outs;
+    };
+
+    // Below a few chunks, there's too little overlap between the stages to pay for
+    // handing chunks between threads
+    static constexpr size_t kPipelineChunkSize = 64;
+    static constexpr size_t kMinPipelinedSamples = 4 * kPipelineChunkSize;
+
+    //==============================================================================
+    // Upmix to NumLines channels: [xl, xr, mid, side] followed by alternating
+    // sign-inverted copies of the same four
+    void upmixStereo (Lines const& l, FloatType const* xl, FloatType const* xr, size_t numSamples)
+    {
+        for (size_t k = 0; k < numSamples; ++k) {
+            auto const mid = FloatType(0.5) * (xl[k] + xr[k]);
+            auto const side = FloatType(0.5) * (xl[k] - xr[k]);
+
+            for (size_t i = 0; i < NumLines; i += 4) {
+                auto const sign = ((i / 4) % 2 == 0) ? FloatType(1) : FloatType(-1);
+
+                l[i + 0][k] = sign * xl[k];
+                l[i + 1][k] = sign * xr[k];
+                l[i + 2][k] = sign * mid;
+                l[i + 3][k] = sign * side;
+            }
+        }
+    }
+
+    // Any other channel count goes round the lines in turn, with every other pass
+    // sign-inverted, so that each channel lands on at least one line of its own
+    void upmix (Lines const& l, Inputs const& ins, size_t start, size_t numSamples)
+    {
+        for (size_t i = 0; i < NumLines; ++i) {
+            auto const* x = ins[i % channels] + start;
+            auto const sign = ((i / channels) % 2 == 0) ? FloatType(1) : FloatType(-1);
+
+            for (size_t k = 0; k < numSamples; ++k) {
+                l[i][k] = sign * x[k];
+            }
+        }
+    }
+
+    // We interleave the output channels here because the delay lengths in the
+    // network correlate with the line index; summing the lower half into the left
+    // and the upper half into the right builds energy in the left channel first.
+    //
+    // Each channel sums NumLines / 2 largely uncorrelated lines, so we scale by
+    // 1 / sqrt(2 * NumLines) to hold the level steady across line counts, which
+    // comes to the 2 / NumLines we've always used at eight lines.
+    void downmixStereo (Lines const& l, FloatType* outL, FloatType* outR, size_t numSamples)
+    {
+        auto const gain = FloatType(1) / std::sqrt(FloatType(2 * NumLines));
+
+        for (size_t i = 0; i < NumLines; ++i) {
+            auto* out = (i % 2 == 0) ? outL : outR;
+
+            for (size_t k = 0; k < numSamples; ++k) {
+                out[k] += gain * l[i][k];
+            }
+        }
+    }
+
+    // Every output takes its own row of one more Hadamard mix, so each one hears
+    // every line, each with a different pattern of signs, and no two outputs are
+    // correlated. That keeps the decode at N log2(N) per frame however many
+    // channels we have. The mix is orthogonal, so each output carries the energy
+    // of one line, and a gain of 1/2 matches the level of the stereo downmix.
+    void decode (Lines const& l, Outputs const& outs, size_t start, size_t numSamples)
+    {
+        hadamardInPlace<FloatType, NumLines>(l, numSamples);
+
+        for (size_t ch = 0; ch < channels; ++ch) {
+            auto* out = outs[ch] + start;
+
+            for (size_t k = 0; k < numSamples; ++k) {
+                out[k] += FloatType(0.5) * l[ch][k];
+            }
+        }
+    }
+
+    //==============================================================================
+    // One diffusion step's worth of fixed delays, where line i is delayed by
+    // (i + 1) / NumLines of the step size
+    struct DiffusionStep
+    {
+        void prepare (double stepSizeInSamples)
+        {
+            for (size_t i = 0; i < NumLines; ++i) {
+                lengths[i] = static_cast<size_t>(stepSizeInSamples * (static_cast<double>(i + 1) / NumLines));
+            }
+
+            delay.prepare(*std::max_element(lengths.begin(), lengths.end()));
+        }
+
+        void process (std::array<FloatType*, NumLines> const& lines, size_t numSamples)
+        {
+            typename InterleavedDelay<FloatType, NumLines>::Frame frame;
+
+            for (size_t k = 0; k < numSamples; ++k) {
+                for (size_t i = 0; i < NumLines; ++i)
+                    frame[i] = lines[i][k];
+
+                delay.process(frame, lengths);
+
+                for (size_t i = 0; i < NumLines; ++i)
+                    lines[i][k] = frame[i];
+            }
+        }
+
+        InterleavedDelay<FloatType, NumLines> delay;
+        std::array<size_t, NumLines> lengths {};
+    };
+
+    //==============================================================================
+    // A damped feedback delay network with a one-pole lowpass in the feedback path
+    // and modulated, linearly interpolated read positions on each line.
+    //
+    // The feedback path carries exactly one block of latency, the same as the
+    // el.tapIn/el.tapOut pair it replaces, which is also what lets us run the damping
+    // and mixing steps over whole blocks. All of the delay lines share one
+    // InterleavedDelay and are written, read and interpolated together per frame.
+    struct FDN
+    {
+        void prepare (double fs, size_t bs)
+        {
+            sampleRate = fs;
+            blockSize = bs;
+
+            // Room for the longest line at the largest size, plus modulation
+            auto const maxDelaySeconds = std::max(0.75, NumLines * 0.017 * 4.0 + 0.01);
+            delay.prepare(static_cast<size_t>(std::ceil(fs * maxDelaySeconds)));
+
+            for (size_t i = 0; i < NumLines; ++i) {
+                feedback[i].assign(bs, FloatType(0));
+
+                // Each delay line here is ((i + 1) * 17)ms long, multiplied by [1, 4]
+                // depending on the size parameter
+                baseDelay[i] = static_cast<FloatType>(fs * ((i + 1) * 17.0 / 1000.0));
+            }
+
+            modAmount = static_cast<FloatType>(fs * (2.5 / 1000.0));
+            feedbackIndex = 0;
+            dampState.fill(FloatType(0));
+            phase.fill(FloatType(0));
+        }
+
+        void process (std::array<FloatType*, NumLines> const& lines, size_t numSamples, FloatType const* size, FloatType const* decay, FloatType const* mod, bool fastMath)
+        {
+            // The unity-gain one pole lowpass here is tuned to taste along
+            // the range [0.001, 0.5]. Towards the top of the range, we get into the region
+            // of killing the decay time too quickly. Towards the bottom, not much damping.
+            constexpr FloatType p = FloatType(0.105);
+
+            for (size_t i = 0; i < NumLines; ++i) {
+                auto* x = lines[i];
+                auto const* fb = feedback[i].data();
+                auto z = dampState[i];
+
+                for (size_t k = 0, f = feedbackIndex; k < numSamples; ++k) {
+                    z = (FloatType(1) - p) * fb[f] + p * z;
+                    x[k] += decay[k] * z;
+
+                    if (++f >= blockSize)
+                        f = 0;
+                }
+
+                dampState[i] = z;
+            }
+
+            hadamardInPlace<FloatType, NumLines>(lines, numSamples);
+
+            if (fastMath)
+                modulateAndDelay<true>(lines, numSamples, size, mod);
+            else
+                modulateAndDelay<false>(lines, numSamples, size, mod);
+        }
+
+        template <bool ApproximateSine>
+        void modulateAndDelay (std::array<FloatType*, NumLines> const& lines, size_t numSamples, FloatType const* size, FloatType const* mod)
+        {
+            auto const twoPi = static_cast<FloatType>(2.0 * 3.141592653589793);
+            auto const invSampleRate = static_cast<FloatType>(1.0 / sampleRate);
+
+            typename InterleavedDelay<FloatType, NumLines>::Frame frame, delays;
+
+            for (size_t k = 0, f = feedbackIndex; k < numSamples; ++k) {
+                // Modulate the read position for each line to add some chorus
+                auto const delayScale = FloatType(1) + FloatType(3) * size[k];
+                auto const rateScale = mod[k] * FloatType(0.02);
+
+                for (size_t i = 0; i < NumLines; ++i) {
+                    auto const lfo = ApproximateSine ? fastSin2Pi(phase[i]) : std::sin(twoPi * phase[i]);
+                    delays[i] = std::max(FloatType(1), delayScale * baseDelay[i] + modAmount * lfo);
+
+                    // Phases advance by far less than a cycle per sample, so wrapping
+                    // them back into [0, 1) takes no floor()
+                    phase[i] += (FloatType(0.1) + FloatType(i) * rateScale) * invSampleRate;
+                    phase[i] -= phase[i] >= FloatType(1) ? FloatType(1) : FloatType(0);
+                }
+
+                for (size_t i = 0; i < NumLines; ++i)
+                    frame[i] = lines[i][k];
+
+                delay.process(frame, delays);
+
+                for (size_t i = 0; i < NumLines; ++i) {
+                    lines[i][k] = frame[i];
+                    feedback[i][f] = frame[i];
+                }
+
+                if (++f >= blockSize)
+                    f = 0;
+            }
+
+            feedbackIndex = (feedbackIndex + numSamples) % blockSize;
+        }
+
+        double sampleRate = 44100.0;
+        size_t blockSize = 1;
+
+        InterleavedDelay<FloatType, NumLines> delay;
+        std::array<std::vector<FloatType>, NumLines> feedback;
+        std::array<FloatType, NumLines> baseDelay {};
+        std::array<FloatType, NumLines> dampState {};
+        std::array<FloatType, NumLines> phase {};
+
+        FloatType modAmount = 0;
+        size_t feedbackIndex = 0;
+    };
+
+    size_t channels = 2;
+
+    std::array<std::vector<FloatType>, NumLines> lineData;
+    Lines lines {};
+
+    std::array<DiffusionStep, 3> diffusers;
+    std::array<FDN, 2> fdns;
+
+    std::vector<FloatType> constantDecay;
+};
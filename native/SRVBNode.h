@@ -0,0 +1,571 @@
+#pragma once
+
+#include <elem/GraphNode.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HalfBand.h"
+#include "NodeProfiler.h"
+#include "SRVBNetwork.h"
+#include "Telemetry.h"
+
+
+//==============================================================================
+// The whole SRVB wet network as a single native node.
+//
+// This replaces the diffusion and damped FDN steps that srvb.js used to build out
+// of several hundred tiny `el.mul`/`el.add`/`el.sdelay`/`el.delay` nodes. The
+// topology is unchanged, and lives in SRVBNetwork: the stereo input is upmixed to
+// a number of lines, run through three diffusion steps and two damped feedback
+// delay networks, and downmixed back to stereo.
+//
+// Children, in order: size, decay, mod, then one input per channel. Each is
+// expected to be a (smoothed) signal; size, decay and mod in the range [0, 1].
+//
+// Produces one output per channel carrying the wet signal. The wet/dry mix is
+// left to the JavaScript side.
+//
+// The "channels" prop, set when the node is created, gives the channel count, from
+// 1 to 16, and defaults to stereo. Every channel shares the one network, which
+// runs at least as many lines as there are channels.
+//
+// The "lines" prop picks a network of 4, 8 (the default) or 16 lines, and may
+// change at any time: the new network is built on the thread that sets the prop,
+// then the audio thread crossfades into it over kCrossfadeSeconds while the old
+// one keeps ringing, so that the new tail has time to build up.
+//
+// A "fastMath" prop swaps the delay modulators' std::sin for fastSin2Pi() (see
+// FastMath.h), which vectorises. The tail stays within the precise path's own
+// rounding noise of it. It may change at any time.
+//
+// An optional "decimation" prop of 2 or 4, set when the node is created, runs the
+// network at that fraction of the sample rate between half-band decimators and
+// interpolators, at a fixed latency of a few samples on the wet signal.
+//
+// Given a NodeProfiler, the node times its diffusion, feedback, downmix and
+// resampling stages separately, as "<key>/diffusion" and so on, while profiling
+// is enabled. Given a BlockTelemetry, it adds the energy of its output there for
+// the editor's wet meter while that's enabled.
+//
+// Given a pipeline slot, the node hands its network whatever StagePipeline the slot
+// holds at the start of each block, if any, for it to run the network's stages
+// across threads (see SRVBNetwork::process). The owner fills the slot on the audio
+// thread, and only for offline blocks, which can afford to wait on other threads.
+template <typename FloatType>
+struct SRVBNode : public elem::GraphNode<FloatType>
+{
+    using Network = SRVBNetworkBase<FloatType>;
+    using Inputs = typename Network::Inputs;
+    using Outputs = typename Network::Outputs;
+
+    static constexpr size_t MaxChannels = Network::MaxChannels;
+
+    // About as long as the sixteen line network takes to fill up from silence
+    static constexpr double kCrossfadeSeconds = 2.0;
+
+    SRVBNode(elem::NodeId id, double sampleRate, int const blockSize, NodeProfiler* nodeProfiler = nullptr, BlockTelemetry* blockTelemetry = nullptr,
+             StagePipeline* const* stagePipelineSlot = nullptr)
+        : elem::GraphNode<FloatType>::GraphNode(id, sampleRate, blockSize)
+        , fullSampleRate(sampleRate)
+        , maxBlockSize(static_cast<size_t>(std::max(1, blockSize)))
+        , profiler(nodeProfiler)
+        , telemetry(blockTelemetry)
+        , pipelineSlot(stagePipelineSlot)
+    {
+        prepare();
+
+        std::ostringstream name;
+        name << "srvb#" << std::hex << id;
+        acquireStageEntries(name.str());
+    }
+
+    ~SRVBNode() override
+    {
+        delete pendingNetwork.exchange(nullptr);
+        delete retiredNetwork.exchange(nullptr);
+    }
+
+    int setProperty(std::string const& key, elem::js::Value const& val) override
+    {
+        if (key == "decimation") {
+            if (!val.isNumber())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            auto const factor = static_cast<size_t>(val.getNumber());
+
+            if (factor != 1 && factor != 2 && factor != 4)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            // A different factor renders as a different node (see srvb.js), so this
+            // is set exactly once, before the audio thread ever sees us
+            if (hasDecimation && factor != decimation)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            if (!hasDecimation)
+                setDecimation(factor);
+        }
+
+        if (key == "channels") {
+            if (!val.isNumber())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            auto const n = static_cast<size_t>(val.getNumber());
+
+            if (n < 1 || n > MaxChannels)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            // Likewise, a different channel count renders as a different node
+            if (hasNumChannels && n != numChannels)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            if (!hasNumChannels)
+                setNumChannels(n);
+        }
+
+        if (key == "key" && val.isString())
+            acquireStageEntries(val.getString());
+
+        if (key == "fastMath") {
+            if (!val.isBool())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            fastMath.store(static_cast<bool>(val), std::memory_order_relaxed);
+        }
+
+        if (key == "lines") {
+            if (!val.isNumber())
+                return elem::ReturnCode::InvalidPropertyType();
+
+            auto const n = static_cast<size_t>(val.getNumber());
+
+            if (n != 4 && n != 8 && n != 16)
+                return elem::ReturnCode::InvalidPropertyValue();
+
+            setNumLines(n);
+        }
+
+        return elem::GraphNode<FloatType>::setProperty(key, val);
+    }
+
+    /** The line count we actually run for a requested line count: never fewer lines than
+        channels, so that every channel has a line of its own.
+    */
+    static size_t getNumLinesFor (size_t requestedLines, size_t channels)
+    {
+        size_t n = std::max<size_t>(4, requestedLines);
+
+        while (n < channels && n < 16)
+            n *= 2;
+
+        return n;
+    }
+
+    /** Estimates how long a network of numLines lines rings on, to -60dB, once its input stops.
+
+        The input reaches the feedback network through up to 257ms of diffusion, and then
+        circulates through delay lines averaging (numLines + 1) / 2 * 17ms, scaled by
+        [1, 4] with size, plus one block for the feedback path. Each trip round the loop
+        scales it by `decay`, so falling by 60dB takes log(10^-3) / log(decay) trips.
+    */
+    static double getTailLengthSeconds (double size, double decay, double sampleRate, int blockSize, size_t numLines = 8)
+    {
+        if (decay >= 1.0)
+            return std::numeric_limits<double>::infinity();
+
+        auto const meanLineSeconds = (static_cast<double>(numLines) + 1.0) / 2.0 * 0.017;
+        auto const loopSeconds = meanLineSeconds * (1.0 + 3.0 * std::clamp(size, 0.0, 1.0))
+            + ((sampleRate > 0) ? static_cast<double>(blockSize) / sampleRate : 0.0);
+
+        auto const numTrips = (decay > 0) ? -3.0 / std::log10(decay) : 0.0;
+        return 0.257 + loopSeconds * (1.0 + numTrips);
+    }
+
+    void process (elem::BlockContext<FloatType> const& ctx) override
+    {
+        auto** outputData = ctx.outputData;
+        auto const numOuts = ctx.numOutputChannels;
+
+        for (size_t j = 0; j < numOuts; ++j) {
+            std::fill_n(outputData[j], ctx.numSamples, FloatType(0));
+        }
+
+        if (ctx.numInputChannels < 3 + numChannels || numOuts < 1)
+            return;
+
+        auto const* size = ctx.inputData[0];
+        auto const* decay = ctx.inputData[1];
+        auto const* mod = ctx.inputData[2];
+
+        // With fewer outputs than channels, the extra channels sum into the outputs
+        // we do have
+        auto const numDistinct = std::min(numOuts, numChannels);
+
+        Inputs ins {};
+        Outputs outs {};
+
+        for (size_t ch = 0; ch < numChannels; ++ch) {
+            ins[ch] = ctx.inputData[3 + ch];
+            outs[ch] = outputData[ch % numDistinct];
+        }
+
+        auto const numSamples = std::min(ctx.numSamples, maxBlockSize);
+
+        if (decimation == 1) {
+            processNetworks(size, decay, mod, ins, numSamples, outs, numDistinct);
+        } else {
+            processReducedRate(size, decay, mod, ins, numSamples, outs);
+        }
+
+        // The wet meter follows the front pair
+        if (telemetry != nullptr && telemetry->enabled) {
+            for (size_t j = 0; j < std::min<size_t>(numDistinct, 2); ++j)
+                telemetry->addWet(j, outputData[j], numSamples);
+        }
+    }
+
+private:
+    //==============================================================================
+    // The network's own stages, then ours
+    static constexpr size_t ResampleStage = Network::NumStages;
+    static constexpr size_t NumStageEntries = ResampleStage + 1;
+
+    void acquireStageEntries (std::string const& name)
+    {
+        if (profiler == nullptr)
+            return;
+
+        std::array<char const*, NumStageEntries> const stageNames {{ "diffusion", "fdn", "downmix", "resample" }};
+
+        for (size_t i = 0; i < NumStageEntries; ++i)
+            stageEntries[i].store(profiler->acquire(name + "/" + stageNames[i]), std::memory_order_release);
+    }
+
+    bool isProfiling() const
+    {
+        return profiler != nullptr && profiler->isEnabled();
+    }
+
+    std::unique_ptr<Network> makeNetwork (size_t requestedLines) const
+    {
+        switch (getNumLinesFor(requestedLines, numChannels)) {
+            case 4: return std::make_unique<SRVBNetwork<FloatType, 4>>(networkSampleRate, networkBlockSize, numChannels);
+            case 16: return std::make_unique<SRVBNetwork<FloatType, 16>>(networkSampleRate, networkBlockSize, numChannels);
+            default: return std::make_unique<SRVBNetwork<FloatType, 8>>(networkSampleRate, networkBlockSize, numChannels);
+        }
+    }
+
+    // Builds the active network, and the crossfade buffers, to run at the given
+    // rate in blocks of up to bs samples. Only before the audio thread sees us.
+    void prepareNetworks (double sampleRate, size_t bs)
+    {
+        networkSampleRate = sampleRate;
+        networkBlockSize = bs;
+        crossfadeLength = std::max<size_t>(1, static_cast<size_t>(kCrossfadeSeconds * sampleRate));
+
+        active = makeNetwork(numLines);
+
+        for (size_t ch = 0; ch < MaxChannels; ++ch)
+            fadeBuffers[ch].assign((ch < numChannels) ? bs : 0, FloatType(0));
+    }
+
+    // Builds everything for the current decimation, channel count and line count.
+    // Each of those arrives as a prop, in whatever order, before the audio thread
+    // ever sees us, and each one prepares us again from scratch.
+    void prepare()
+    {
+        if (decimation == 1)
+            return prepareNetworks(fullSampleRate, maxBlockSize);
+
+        // Each stage holds back at most one sample, so one block never yields more
+        // than ceil(maxBlockSize / factor) samples at the reduced rate
+        auto const reducedBlockSize = (maxBlockSize + decimation - 1) / decimation;
+
+        prepareNetworks(fullSampleRate / static_cast<double>(decimation), reducedBlockSize);
+
+        for (auto* v : { &reducedSize, &reducedDecay, &reducedMod })
+            v->assign(reducedBlockSize, FloatType(0));
+
+        for (size_t ch = 0; ch < MaxChannels; ++ch) {
+            auto const used = ch < numChannels;
+
+            reducedInput[ch].assign(used ? maxBlockSize : 0, FloatType(0));
+            reducedOutput[ch].assign(used ? reducedBlockSize : 0, FloatType(0));
+            upsampled[ch].assign(used ? 2 * reducedBlockSize : 0, FloatType(0));
+            outputFifo[ch].assign(used ? maxBlockSize + 2 * decimation : 0, FloatType(0));
+
+            for (auto& d : decimators[ch])
+                d.reset();
+
+            for (auto& i : interpolators[ch])
+                i.reset();
+        }
+
+        // Over any run of blocks, the stages produce a multiple of `factor` samples
+        // which trails the input by at most factor - 1, so priming the output with
+        // that many zeros means every block can be filled in full
+        fifoCount = decimation - 1;
+    }
+
+    // The first line count arrives along with the node itself, before the audio
+    // thread ever sees us, and simply replaces the default network. After that, we
+    // build the new network here and hand it over to the audio thread.
+    void setNumLines (size_t n)
+    {
+        if (!hasNumLines) {
+            hasNumLines = true;
+
+            if (n != numLines) {
+                numLines = n;
+                prepare();
+            }
+
+            return;
+        }
+
+        if (n == numLines)
+            return;
+
+        numLines = n;
+
+        // Free whatever the audio thread has finished with, and anything it never
+        // got round to picking up
+        delete retiredNetwork.exchange(nullptr, std::memory_order_acquire);
+        delete pendingNetwork.exchange(makeNetwork(n).release(), std::memory_order_acq_rel);
+    }
+
+    void setNumChannels (size_t n)
+    {
+        numChannels = n;
+        hasNumChannels = true;
+        prepare();
+    }
+
+    // Runs the network at fullSampleRate / factor, between cascades of log2(factor)
+    // half-band stages. Everything in the network is specified in milliseconds, so
+    // preparing it at the reduced rate keeps every delay time where it was.
+    void setDecimation (size_t factor)
+    {
+        decimation = factor;
+        hasDecimation = true;
+        numStages = (factor == 4) ? 2 : ((factor == 2) ? 1 : 0);
+
+        prepare();
+    }
+
+    //==============================================================================
+    // Runs the active network over one block at the network rate, crossfading from
+    // the previous one if we're part way through a switch. Of the outputs, only the
+    // first numDistinct are different buffers; the rest repeat them.
+    void processNetworks (FloatType const* size, FloatType const* decay, FloatType const* mod,
+                          Inputs const& ins, size_t numSamples, Outputs const& outs, size_t numDistinct)
+    {
+        // Hand back the network we last faded out of, once the previous one has been
+        // collected, and only then start on the next switch
+        if (finished != nullptr) {
+            Network* expected = nullptr;
+
+            if (retiredNetwork.compare_exchange_strong(expected, finished.get(), std::memory_order_release))
+                finished.release();
+        }
+
+        if (fadingOut == nullptr && finished == nullptr) {
+            if (auto* next = pendingNetwork.exchange(nullptr, std::memory_order_acquire)) {
+                fadingOut = std::move(active);
+                active.reset(next);
+                crossfadePosition = 0;
+            }
+        }
+
+        auto const profiling = isProfiling();
+        auto const approximate = fastMath.load(std::memory_order_relaxed);
+        auto* const pipeline = (pipelineSlot != nullptr) ? *pipelineSlot : nullptr;
+
+        active->timeStages = profiling;
+        active->fastMath = approximate;
+        active->pipeline = pipeline;
+
+        if (fadingOut == nullptr) {
+            active->process(size, decay, mod, ins, numSamples, outs);
+            return collectStageTimes(profiling);
+        }
+
+        fadingOut->timeStages = profiling;
+        fadingOut->fastMath = approximate;
+        fadingOut->pipeline = pipeline;
+
+        // Both networks see the same input, and we mix their outputs along an
+        // equal-power curve, which suits two largely uncorrelated reverb tails
+        // Where channels share an output, the same goes for the network we're fading in
+        Outputs fadeOuts {};
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            fadeOuts[ch] = fadeBuffers[ch % numDistinct].data();
+
+        for (size_t ch = 0; ch < numDistinct; ++ch)
+            std::fill_n(fadeOuts[ch], numSamples, FloatType(0));
+
+        fadingOut->process(size, decay, mod, ins, numSamples, outs);
+        active->process(size, decay, mod, ins, numSamples, fadeOuts);
+
+        auto const halfPi = static_cast<FloatType>(1.5707963267948966);
+        auto const invLength = FloatType(1) / static_cast<FloatType>(crossfadeLength);
+
+        for (size_t k = 0; k < numSamples; ++k) {
+            auto const t = std::min(FloatType(1), static_cast<FloatType>(crossfadePosition + k) * invLength);
+            auto const gainOut = std::cos(halfPi * t);
+            auto const gainIn = std::sin(halfPi * t);
+
+            for (size_t ch = 0; ch < numDistinct; ++ch)
+                outs[ch][k] = gainOut * outs[ch][k] + gainIn * fadeOuts[ch][k];
+        }
+
+        crossfadePosition += numSamples;
+        collectStageTimes(profiling);
+
+        if (crossfadePosition >= crossfadeLength)
+            finished = std::move(fadingOut);
+    }
+
+    // Moves the stage times the networks gathered over to the profiler
+    void collectStageTimes (bool profiling)
+    {
+        if (!profiling)
+            return;
+
+        for (auto* network : { active.get(), fadingOut.get() }) {
+            if (network == nullptr)
+                continue;
+
+            for (size_t i = 0; i < Network::NumStages; ++i) {
+                if (network->stageNanos[i] > 0)
+                    NodeProfiler::record(stageEntries[i].load(std::memory_order_acquire), network->stageNanos[i]);
+
+                network->stageNanos[i] = 0;
+            }
+        }
+    }
+
+    void processReducedRate (FloatType const* size, FloatType const* decay, FloatType const* mod,
+                             Inputs const& ins, size_t numSamples, Outputs const& outs)
+    {
+        size_t numReduced = 0;
+
+        auto const profiling = isProfiling();
+        auto const start = profiling ? NodeProfiler::now() : 0;
+
+        // Decimate the input, in place after the first stage
+        for (size_t ch = 0; ch < numChannels; ++ch) {
+            auto* buffer = reducedInput[ch].data();
+            numReduced = decimators[ch][0].process(ins[ch], numSamples, buffer);
+
+            for (size_t s = 1; s < numStages; ++s)
+                numReduced = decimators[ch][s].process(buffer, numReduced, buffer);
+        }
+
+        // The control signals are smoothed upstream, so we just take the latest value
+        // at each reduced-rate sample rather than filtering them
+        for (size_t k = 0; k < numReduced; ++k) {
+            auto const j = std::min(numSamples - 1, (k + 1) * decimation - 1);
+
+            reducedSize[k] = size[j];
+            reducedDecay[k] = decay[j];
+            reducedMod[k] = mod[j];
+        }
+
+        Inputs reducedIns {};
+        Outputs reducedOuts {};
+
+        for (size_t ch = 0; ch < numChannels; ++ch) {
+            reducedIns[ch] = reducedInput[ch].data();
+            reducedOuts[ch] = reducedOutput[ch].data();
+            std::fill_n(reducedOuts[ch], numReduced, FloatType(0));
+        }
+
+        auto const decimated = profiling ? NodeProfiler::now() : 0;
+
+        processNetworks(reducedSize.data(), reducedDecay.data(), reducedMod.data(),
+                        reducedIns, numReduced, reducedOuts, numChannels);
+
+        auto const interpolating = profiling ? NodeProfiler::now() : 0;
+
+        // Interpolate back up, with the last stage writing straight onto the end of
+        // the output fifo
+        auto const numProduced = numReduced * decimation;
+
+        for (size_t ch = 0; ch < numChannels; ++ch) {
+            auto* fifo = outputFifo[ch].data();
+            auto* tail = fifo + fifoCount;
+
+            if (numStages == 2) {
+                interpolators[ch][1].process(reducedOutput[ch].data(), numReduced, upsampled[ch].data());
+                interpolators[ch][0].process(upsampled[ch].data(), 2 * numReduced, tail);
+            } else {
+                interpolators[ch][0].process(reducedOutput[ch].data(), numReduced, tail);
+            }
+
+            auto const available = fifoCount + numProduced;
+            auto const n = std::min(numSamples, available);
+
+            for (size_t k = 0; k < n; ++k)
+                outs[ch][k] += fifo[k];
+
+            std::copy(fifo + n, fifo + available, fifo);
+        }
+
+        fifoCount = fifoCount + numProduced - std::min(numSamples, fifoCount + numProduced);
+
+        if (profiling)
+            NodeProfiler::record(stageEntries[ResampleStage].load(std::memory_order_acquire), (decimated - start) + (NodeProfiler::now() - interpolating));
+    }
+
+    //==============================================================================
+    double fullSampleRate = 44100.0;
+    size_t maxBlockSize = 1;
+
+    // Owned by the audio thread once it's running, apart from the two handover slots
+    std::unique_ptr<Network> active;
+    std::unique_ptr<Network> fadingOut;
+    std::unique_ptr<Network> finished;
+    std::atomic<Network*> pendingNetwork { nullptr };
+    std::atomic<Network*> retiredNetwork { nullptr };
+
+    size_t numLines = 8;
+    bool hasNumLines = false;
+
+    size_t numChannels = 2;
+    bool hasNumChannels = false;
+
+    std::atomic<bool> fastMath { false };
+
+    double networkSampleRate = 44100.0;
+    size_t networkBlockSize = 1;
+    size_t crossfadeLength = 1;
+    size_t crossfadePosition = 0;
+    std::array<std::vector<FloatType>, MaxChannels> fadeBuffers;
+
+    NodeProfiler* profiler = nullptr;
+    BlockTelemetry* telemetry = nullptr;
+    std::array<std::atomic<NodeProfiler::Entry*>, NumStageEntries> stageEntries {};
+
+    StagePipeline* const* pipelineSlot = nullptr;
+
+    //==============================================================================
+    size_t decimation = 1;
+    size_t numStages = 0;
+    bool hasDecimation = false;
+
+    std::array<std::array<HalfBandDecimator<FloatType>, 2>, MaxChannels> decimators;
+    std::array<std::array<HalfBandInterpolator<FloatType>, 2>, MaxChannels> interpolators;
+
+    std::vector<FloatType> reducedSize, reducedDecay, reducedMod;
+    std::array<std::vector<FloatType>, MaxChannels> reducedInput, reducedOutput, upsampled, outputFifo;
+    size_t fifoCount = 0;
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP > 0)
+ #include <xmmintrin.h>
+ #define ELEM_STAGE_PIPELINE_MXCSR 1
+#elif defined(__aarch64__)
+ #define ELEM_STAGE_PIPELINE_FPCR 1
+#endif
+
+
+//==============================================================================
+// Runs a chain of processing stages over a block, as a pipeline across threads.
+//
+// The block is split into chunks, and each stage runs over the chunks in order on
+// a thread of its own: the first on the caller's thread, the rest on our workers.
+// A stage starts on a chunk once it has finished the chunk before, and the stage
+// before it has finished this one. So while the first stage works on the third
+// chunk, the second stage works on the second and the third stage on the first.
+//
+// Every stage sees exactly the samples, in exactly the order, that it would see
+// running the whole block itself, so the result is bit-identical to running the
+// stages one after the other, as long as each stage only touches its own state and
+// its own chunk of the buffers between stages. The workers take on the caller's
+// floating point modes for each block, so denormals flush there if they flush here.
+//
+// One pipeline serves the whole process, and runs one block at a time. A caller
+// that finds it busy, or on a machine with a single core, gets false back from
+// run() and runs its stages itself.
+//
+// This is for offline rendering only. The caller waits on the workers, which don't
+// run at real-time priority, and waking them and handing chunks between threads
+// costs a few microseconds each time. Nothing here allocates or takes a lock on the
+// caller's side, though.
+class StagePipeline
+{
+public:
+    static constexpr size_t kMaxStages = 3;
+
+    /** What the pipeline runs. runStage() is called once per stage per chunk, for each
+        stage on one thread, and each chunk in order.
+    */
+    struct Job {
+        virtual ~Job() = default;
+        virtual void runStage (size_t stage, size_t start, size_t numSamples) = 0;
+    };
+
+    //==============================================================================
+    /** Returns the process-wide pipeline, starting its workers the first time anyone
+        asks, or nullptr if there's only the one core to run on. Not for the real-time
+        thread.
+    */
+    static std::shared_ptr<StagePipeline> acquire()
+    {
+        static std::mutex instanceLock;
+        static std::weak_ptr<StagePipeline> instance;
+
+        if (std::thread::hardware_concurrency() < 2)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(instanceLock);
+        auto pipeline = instance.lock();
+
+        if (pipeline == nullptr) {
+            pipeline = std::shared_ptr<StagePipeline>(new StagePipeline());
+            instance = pipeline;
+        }
+
+        return pipeline;
+    }
+
+    ~StagePipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+            shouldExit.store(true);
+        }
+
+        wake.notify_all();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+    //==============================================================================
+    /** Runs numStages stages of the job over numSamples samples, in chunks of
+        chunkSize. Returns false, having run nothing, if the pipeline's busy with
+        another block.
+    */
+    bool run (Job& job, size_t numStages, size_t numSamples, size_t chunkSize)
+    {
+        numStages = std::clamp<size_t>(numStages, 1, kMaxStages);
+        chunkSize = std::max<size_t>(1, chunkSize);
+
+        if (busy.exchange(true, std::memory_order_acquire))
+            return false;
+
+        currentJob = &job;
+        currentNumStages = numStages;
+        currentNumSamples = numSamples;
+        currentChunkSize = chunkSize;
+        currentNumChunks = (numSamples + chunkSize - 1) / chunkSize;
+        currentFloatControl = getFloatControl();
+
+        for (auto& p : progress)
+            p.store(0, std::memory_order_relaxed);
+
+        numWorkersDone.store(0, std::memory_order_relaxed);
+
+        // Publishing the new generation hands the job to the workers, and only those
+        // that gave up waiting for it need waking. We never take their lock to do it,
+        // so a worker just about to go to sleep as we publish can miss the nudge, and
+        // picks the job up kSleepTimeout later instead.
+        generation.fetch_add(1, std::memory_order_seq_cst);
+
+        if (numSleeping.load(std::memory_order_seq_cst) > 0)
+            wake.notify_all();
+
+        runStage(0);
+
+        // Every worker checks in, even those with no stage to run this time, so
+        // that none of them is still reading this block's job when the next comes
+        while (numWorkersDone.load(std::memory_order_acquire) < workers.size())
+            std::this_thread::yield();
+
+        currentJob = nullptr;
+        busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+private:
+    //==============================================================================
+    StagePipeline()
+    {
+        for (size_t stage = 1; stage < kMaxStages; ++stage)
+            workers.emplace_back([this, stage]() { workerLoop(stage); });
+    }
+
+    void workerLoop (size_t stage)
+    {
+        uint64_t seen = 0;
+
+        while (!shouldExit.load()) {
+            // Offline renders come back for the next block almost at once, so we keep
+            // an eye out for a while before going to sleep
+            for (int i = 0; i < kSpinsBeforeSleeping && generation.load(std::memory_order_acquire) == seen; ++i)
+                std::this_thread::yield();
+
+            if (generation.load(std::memory_order_acquire) == seen) {
+                std::unique_lock<std::mutex> lock(wakeLock);
+                numSleeping.fetch_add(1, std::memory_order_seq_cst);
+
+                while (!shouldExit.load() && generation.load(std::memory_order_seq_cst) == seen)
+                    wake.wait_for(lock, kSleepTimeout);
+
+                numSleeping.fetch_sub(1, std::memory_order_seq_cst);
+            }
+
+            if (shouldExit.load())
+                return;
+
+            seen = generation.load(std::memory_order_acquire);
+
+            if (stage < currentNumStages) {
+                if (getFloatControl() != currentFloatControl)
+                    setFloatControl(currentFloatControl);
+
+                runStage(stage);
+            }
+
+            numWorkersDone.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void runStage (size_t stage)
+    {
+        for (size_t c = 0; c < currentNumChunks; ++c) {
+            if (stage > 0)
+                awaitProgress(stage - 1, c + 1);
+
+            auto const start = c * currentChunkSize;
+            currentJob->runStage(stage, start, std::min(currentChunkSize, currentNumSamples - start));
+
+            progress[stage].store(c + 1, std::memory_order_release);
+        }
+    }
+
+    void awaitProgress (size_t stage, size_t numChunks)
+    {
+        while (progress[stage].load(std::memory_order_acquire) < numChunks)
+            std::this_thread::yield();
+    }
+
+    // The floating point control register, which holds the denormal and rounding modes
+    static uint64_t getFloatControl()
+    {
+       #if ELEM_STAGE_PIPELINE_MXCSR
+        return _mm_getcsr();
+       #elif ELEM_STAGE_PIPELINE_FPCR
+        uint64_t fpcr = 0;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        return fpcr;
+       #else
+        return 0;
+       #endif
+    }
+
+    static void setFloatControl (uint64_t control)
+    {
+       #if ELEM_STAGE_PIPELINE_MXCSR
+        _mm_setcsr(static_cast<unsigned int>(control));
+       #elif ELEM_STAGE_PIPELINE_FPCR
+        asm volatile("msr fpcr, %0" : : "r"(control));
+       #else
+        (void) control;
+       #endif
+    }
+
+    //==============================================================================
+    static constexpr int kSpinsBeforeSleeping = 4096;
+    static constexpr std::chrono::milliseconds kSleepTimeout { 10 };
+
+    std::vector<std::thread> workers;
+
+    std::atomic<bool> busy { false };
+    std::atomic<uint64_t> generation { 0 };
+    std::array<std::atomic<size_t>, kMaxStages> progress {};
+    std::atomic<size_t> numWorkersDone { 0 };
+
+    // Written by run() before it publishes a generation, and read by the workers
+    // after they see it
+    Job* currentJob = nullptr;
+    size_t currentNumStages = 0;
+    size_t currentNumSamples = 0;
+    size_t currentChunkSize = 1;
+    size_t currentNumChunks = 0;
+    uint64_t currentFloatControl = 0;
+
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::atomic<int> numSleeping { 0 };
+    std::atomic<bool> shouldExit { false };
+};
@@ -0,0 +1,237 @@
+#include "PluginProcessor.h"
+#include "RealtimeSanitizer.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+//==============================================================================
+// A headless stress test for the real-time safety of EffectsPluginProcessor.
+//
+// Always built with the realtime sanitizer (see RealtimeSanitizer.h). One thread
+// plays the host's audio thread, calling processBlock as fast as it can with block
+// sizes that vary from call to call, and input that comes and goes so that the idle
+// bypass switches in and out. Meanwhile the main thread hammers the processor the
+// way an editor and a host would: parameter changes, structural ones that re-render
+// the graph, resets, and sample rate changes that swap in a fresh runtime. Profiling
+// and telemetry stay on throughout, and get drained as the editor would drain them.
+//
+// Any heap allocation, lock or blocking call inside processBlock is a violation.
+// At the end we print each distinct one with its stack, and exit non-zero if there
+// were any, so that CI fails. With --abort, or ELEM_RT_SANITIZER=abort in the
+// environment, the first violation aborts on the spot instead.
+//
+// With --host-automation, half the parameter changes arrive on the audio thread
+// between blocks, as host automation does, and are held to the same rules as
+// processBlock itself.
+//
+// Usage:
+//   SRVBStress [--assets <dist dir>] [--seconds <n>] [--seed <n>] [--host-automation] [--abort]
+
+//==============================================================================
+struct StressCounts
+{
+    std::atomic<uint64_t> numBlocks { 0 };
+    std::atomic<uint64_t> numSamples { 0 };
+    std::atomic<uint64_t> numHostAutomations { 0 };
+    uint64_t numParameterChanges = 0;
+    uint64_t numRenders = 0;
+    uint64_t numResets = 0;
+    uint64_t numRateChanges = 0;
+};
+
+static constexpr int kMaxBlockSize = 4096;
+static constexpr int kBlockSizes[] = { 1, 16, 32, 64, 100, 128, 256, 480, 512, 513, 1024, 2048, kMaxBlockSize };
+static constexpr double kSampleRates[] = { 44100, 48000, 88200, 96000 };
+
+// Structural parameters re-render the graph in the engine, where everything else
+// only ever reaches the audio thread through `param` nodes
+static bool isStructural(EffectsPluginProcessor const& proc, juce::AudioProcessorParameter const* p)
+{
+    if (auto const* withId = dynamic_cast<juce::AudioProcessorParameterWithID const*>(p))
+        return proc.isStructuralParameter(withId->paramID.toStdString());
+
+    return false;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    auto const cwd = juce::File::getCurrentWorkingDirectory();
+    auto const assetsDir = args.containsOption("--assets")
+        ? cwd.getChildFile(args.removeValueForOption("--assets"))
+        : juce::File(ELEM_TOOLS_ASSETS_DIR);
+
+    if (!assetsDir.getChildFile("manifest.json").existsAsFile() || !assetsDir.getChildFile("dsp.main.js").existsAsFile()) {
+        std::cerr << "Could not find manifest.json and dsp.main.js in " << assetsDir.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    setAssetsDirectory(assetsDir);
+
+    auto const seconds = args.containsOption("--seconds") ? juce::jmax(0.1, args.removeValueForOption("--seconds").getDoubleValue()) : 10.0;
+    auto const seed = args.containsOption("--seed") ? static_cast<uint32_t>(args.removeValueForOption("--seed").getLargeIntValue()) : 1u;
+    auto const hostAutomation = args.containsOption("--host-automation");
+
+    if (args.containsOption("--abort"))
+        RealtimeSanitizer::setAbortOnViolation(true);
+
+    EffectsPluginProcessor proc;
+    auto const& params = proc.getParameters();
+
+    if (params.isEmpty()) {
+        std::cerr << "The manifest declares no parameters" << std::endl;
+        return 1;
+    }
+
+    auto sampleRate = kSampleRates[1];
+    proc.setPlayConfigDetails(2, 2, sampleRate, kMaxBlockSize);
+    proc.prepareToPlay(sampleRate, kMaxBlockSize);
+    proc.handleAsyncUpdate();
+    proc.waitForEngine();
+
+    proc.setProfilingEnabled(true);
+    proc.setTelemetryEnabled(true);
+
+    // Setting up can allocate as it likes; only what follows counts
+    RealtimeSanitizer::clear();
+
+    StressCounts counts;
+    std::atomic<bool> running { true };
+
+    // Held by the audio thread around each block, and by us around anything a host
+    // would never do while processing, the way a plugin wrapper's callback lock is
+    std::mutex callbackLock;
+
+    std::thread audioThread([&]() {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> pickBlockSize(0, std::size(kBlockSizes) - 1);
+        std::uniform_int_distribution<int> pickParam(0, params.size() - 1);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        juce::AudioBuffer<float> storage(2, kMaxBlockSize);
+        juce::MidiBuffer midi;
+        uint64_t blockIndex = 0;
+
+        while (running.load(std::memory_order_relaxed)) {
+            auto const numSamples = kBlockSizes[pickBlockSize(rng)];
+
+            // Bursts of noise with long stretches of silence between them, long enough
+            // to let the tail decay and the processor go idle
+            auto const audible = (blockIndex++ / 256) % 4 == 0;
+
+            for (int ch = 0; ch < 2; ++ch) {
+                auto* data = storage.getWritePointer(ch);
+
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = audible ? noise(rng) : 0.0f;
+            }
+
+            juce::AudioBuffer<float> buffer(storage.getArrayOfWritePointers(), 2, numSamples);
+
+            std::lock_guard<std::mutex> lock(callbackLock);
+
+            if (hostAutomation && unit(rng) < 0.5f) {
+                auto* p = params[pickParam(rng)];
+
+                if (!isStructural(proc, p)) {
+                    RealtimeSanitizer::ScopedRealtime realtimeScope;
+                    p->setValueNotifyingHost(unit(rng));
+                    counts.numHostAutomations.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            proc.processBlock(buffer, midi);
+
+            counts.numBlocks.fetch_add(1, std::memory_order_relaxed);
+            counts.numSamples.fetch_add(static_cast<uint64_t>(numSamples), std::memory_order_relaxed);
+        }
+    });
+
+    std::mt19937 rng(seed + 1);
+    std::uniform_int_distribution<int> pickParam(0, params.size() - 1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    auto const start = std::chrono::steady_clock::now();
+    auto const end = start + std::chrono::duration<double>(seconds);
+
+    while (std::chrono::steady_clock::now() < end) {
+        auto const action = unit(rng);
+
+        if (action < 0.02f) {
+            std::lock_guard<std::mutex> lock(callbackLock);
+            proc.resetRuntime();
+            ++counts.numResets;
+        } else if (action < 0.03f) {
+            std::lock_guard<std::mutex> lock(callbackLock);
+            sampleRate = kSampleRates[static_cast<size_t>(unit(rng) * 0.999f * std::size(kSampleRates))];
+            proc.setPlayConfigDetails(2, 2, sampleRate, kMaxBlockSize);
+            proc.prepareToPlay(sampleRate, kMaxBlockSize);
+            ++counts.numRateChanges;
+        } else {
+            // A handful of parameter changes, as from a drag in the editor or host
+            // automation, now and then including one that re-renders the graph
+            auto const numChanges = 1 + static_cast<int>(unit(rng) * 4.0f);
+
+            for (int i = 0; i < numChanges; ++i) {
+                auto* p = params[pickParam(rng)];
+
+                if (isStructural(proc, p)) {
+                    if (unit(rng) < 0.2f) {
+                        p->setValueNotifyingHost(unit(rng));
+                        ++counts.numRenders;
+                    }
+                } else {
+                    p->setValueNotifyingHost(unit(rng));
+                    ++counts.numParameterChanges;
+                }
+            }
+        }
+
+        // Nothing runs our message loop, so we stand in for it
+        proc.handleAsyncUpdate();
+
+        if (unit(rng) < 0.1f)
+            proc.waitForEngine(1000);
+
+        proc.drainTelemetry();
+        proc.readProfile();
+
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    running.store(false);
+    audioThread.join();
+    proc.waitForEngine(5000);
+
+    auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Ran " << counts.numBlocks.load() << " blocks (" << counts.numSamples.load() << " samples) in " << elapsed << "s, with "
+              << counts.numParameterChanges << " parameter changes, "
+              << counts.numHostAutomations.load() << " on the audio thread, "
+              << counts.numRenders << " structural changes, "
+              << counts.numResets << " resets and "
+              << counts.numRateChanges << " sample rate changes" << std::endl;
+
+    auto const numViolations = RealtimeSanitizer::getNumViolations();
+
+    if (numViolations == 0) {
+        std::cout << "No realtime violations" << std::endl;
+        return 0;
+    }
+
+    auto const numDistinct = RealtimeSanitizer::printReport(std::cout);
+    std::cout << numViolations << " realtime violations, from " << numDistinct << " distinct stacks" << std::endl;
+    return 1;
+}
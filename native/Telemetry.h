@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+//==============================================================================
+// What processBlock measures about each block it runs, for the editor's meters.
+//
+// Frames go from the audio thread to the message thread through a lock-free FIFO,
+// and the editor drains them at display rate, so they hold nothing but numbers.
+struct TelemetryFrame
+{
+    // Enough for the widest layout we run, a 9.1.6 bed
+    static constexpr size_t kMaxChannels = 16;
+
+    // One entry per output channel, for the first numChannels
+    std::array<float, kMaxChannels> peak {};
+    std::array<float, kMaxChannels> sumOfSquares {};
+    uint32_t numChannels = 0;
+
+    // Summed over however many of the wet network's channels we metered
+    float wetSumOfSquares = 0;
+    uint32_t numWetChannels = 0;
+    uint32_t numSamples = 0;
+
+    // Time spent in processBlock, and the real time the block covers
+    uint32_t processNanos = 0;
+    uint32_t budgetNanos = 0;
+
+    bool idle = false;
+};
+
+//==============================================================================
+// Somewhere for our own nodes to leave measurements during a block.
+//
+// Belongs to the audio thread, which resets it before running the graph and reads it
+// back afterwards, so none of this needs to be atomic.
+struct BlockTelemetry
+{
+    void reset (bool shouldMeasure)
+    {
+        enabled = shouldMeasure;
+        wetSumOfSquares = 0;
+        numWetChannels = 0;
+    }
+
+    /** Adds a block of one wet channel's signal, on any number of calls per block. */
+    template <typename FloatType>
+    void addWet (size_t channel, FloatType const* data, size_t numSamples)
+    {
+        numWetChannels = std::max(numWetChannels, static_cast<uint32_t>(channel + 1));
+
+        double sum = 0;
+
+        for (size_t i = 0; i < numSamples; ++i)
+            sum += static_cast<double>(data[i]) * static_cast<double>(data[i]);
+
+        wetSumOfSquares += sum;
+    }
+
+    bool enabled = false;
+    double wetSumOfSquares = 0;
+    uint32_t numWetChannels = 0;
+};
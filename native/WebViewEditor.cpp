@@ -1,5 +1,6 @@
 #include "PluginProcessor.h"
 #include "WebViewEditor.h"
+#include "AssetCache.h"
 
 
 // A helper for reading numbers from a choc::Value, which seems to opportunistically parse
@@ -12,19 +13,6 @@ double numberFromChocValue(const choc::value::ValueView& v) {
                     : (double) v.getInt64())));
 }
 
-std::string getMimeType(std::string const& ext) {
-    static std::unordered_map<std::string, std::string> mimeTypes {
-        { ".html",   "text/html" },
-        { ".js",     "application/javascript" },
-        { ".css",    "text/css" },
-    };
-
-    if (mimeTypes.count(ext) > 0)
-        return mimeTypes.at(ext);
-
-    return "application/octet-stream";
-}
-
 //==============================================================================
 WebViewEditor::WebViewEditor(juce::AudioProcessor* proc, juce::File const& assetDirectory, int width, int height)
     : juce::AudioProcessorEditor(proc)
@@ -38,17 +26,18 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor* proc, juce::File const& asset
 #endif
 
 #if ! ELEM_DEV_LOCALHOST
-    opts.fetchResource = [=](const choc::ui::WebView::Options::Path& p) -> std::optional<choc::ui::WebView::Options::Resource> {
-        auto relPath = "." + (p == "/" ? "/index.html" : p);
-        auto f = assetDirectory.getChildFile(relPath);
-        juce::MemoryBlock mb;
+    // Assets come out of the process-wide cache, so only the first editor of the
+    // session waits on the disk. The WebView wants a buffer of its own for each one,
+    // which is the only copy we make.
+    opts.fetchResource = [assets = AssetCache::get(assetDirectory)](const choc::ui::WebView::Options::Path& p) -> std::optional<choc::ui::WebView::Options::Resource> {
+        auto const* asset = assets->find(p);
 
-        if (!f.existsAsFile() || !f.loadFileAsData(mb))
+        if (asset == nullptr)
             return {};
 
         return choc::ui::WebView::Options::Resource {
-            std::vector<uint8_t>(mb.begin(), mb.end()),
-            getMimeType(f.getFileExtension().toStdString())
+            std::vector<uint8_t>(asset->data, asset->data + asset->size),
+            asset->mimeType
         };
     };
 #endif
@@ -66,30 +55,11 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor* proc, juce::File const& asset
     addAndMakeVisible(viewContainer);
     viewContainer.setBounds({0, 0, 720, 440});
 
-    // Install message passing handlers
-    webView->bind("__postNativeMessage__", [=](const choc::value::ValueView& args) -> choc::value::Value {
-        if (args.isArray()) {
-            auto eventName = args[0].getString();
-
-            // When the webView loads it should send a message telling us that it has established
-            // its message-passing hooks and is ready for a state dispatch
-            if (eventName == "ready") {
-                if (auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor())) {
-                    ptr->dispatchStateChange();
-                }
-            }
-
-#if ELEM_DEV_LOCALHOST
-            if (eventName == "reload") {
-                if (auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor())) {
-                    ptr->initJavaScriptEngine();
-                    ptr->dispatchStateChange();
-                }
-            }
-#endif
-
-            if (eventName == "setParameterValue" && args.size() > 1) {
-                return handleSetParameterValueEvent(args[1]);
+    // The page posts its messages to us in batches, at most one per animation frame
+    webView->bind("__postNativeMessages__", [=](const choc::value::ValueView& args) -> choc::value::Value {
+        if (args.isArray() && args.size() > 0) {
+            for (auto const& m : MessageBus::decode(args[0])) {
+                handleMessage(m);
             }
         }
 
@@ -99,6 +69,25 @@ WebViewEditor::WebViewEditor(juce::AudioProcessor* proc, juce::File const& asset
 #if ELEM_DEV_LOCALHOST
     webView->navigate("http://localhost:5173");
 #endif
+
+    if (auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor())) {
+        ptr->getEditorBus().setConnected(true);
+        ptr->setTelemetryEnabled(true);
+    }
+
+    startTimerHz(kFrameRateHz);
+}
+
+WebViewEditor::~WebViewEditor()
+{
+    stopTimer();
+
+    // Nobody's left to read the profile or the meters once we're gone
+    if (auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor())) {
+        ptr->setProfilingEnabled(false);
+        ptr->setTelemetryEnabled(false);
+        ptr->getEditorBus().setConnected(false);
+    }
 }
 
 choc::ui::WebView* WebViewEditor::getWebViewPtr()
@@ -115,6 +104,70 @@ void WebViewEditor::resized()
     viewContainer.setBounds(getLocalBounds());
 }
 
+void WebViewEditor::timerCallback()
+{
+    auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor());
+
+    if (ptr == nullptr)
+        return;
+
+    // However many blocks ran since the last frame arrive here as one summary, and go
+    // out to the WebView along with everything else posted since, as one script
+    auto const t = ptr->drainTelemetry();
+
+    auto const batch = choc::value::createObject("",
+        "peak", choc::value::createVector(t.peak.data(), t.numChannels),
+        "rms", choc::value::createVector(t.rms.data(), t.numChannels),
+        "wetRms", t.wetRms,
+        "load", t.load,
+        "maxLoad", t.maxLoad,
+        "blocks", static_cast<int64_t>(t.numBlocks),
+        "idleBlocks", static_cast<int64_t>(t.numIdleBlocks),
+        "overruns", static_cast<int64_t>(t.numOverruns),
+        "dropped", static_cast<int64_t>(t.numDroppedFrames));
+
+    auto& bus = ptr->getEditorBus();
+    bus.postTelemetry(batch);
+
+    auto const payload = bus.flush();
+
+    if (!payload.isVoid())
+        webView->evaluateJavascript(MessageBus::toScript(payload));
+}
+
+//==============================================================================
+void WebViewEditor::handleMessage(MessageBus::InboundMessage const& m)
+{
+    auto* ptr = dynamic_cast<EffectsPluginProcessor*>(getAudioProcessor());
+
+    if (ptr == nullptr)
+        return;
+
+    switch (m.type) {
+        // When the page loads it should send a message telling us that it has established
+        // its message-passing hooks and is ready for a state dispatch
+        case MessageBus::InboundMessage::Type::Ready:
+            ptr->dispatchStateChange();
+            break;
+
+        case MessageBus::InboundMessage::Type::Reload:
+#if ELEM_DEV_LOCALHOST
+            ptr->reloadJavaScriptEngine();
+#endif
+            break;
+
+        case MessageBus::InboundMessage::Type::SetParameterValue:
+            handleSetParameterValueEvent(m.payload);
+            break;
+
+        // The profiler panel turns profiling on while it's open, and off again after
+        case MessageBus::InboundMessage::Type::SetProfilingEnabled:
+            if (m.payload.isObject() && m.payload.hasObjectMember("enabled"))
+                ptr->setProfilingEnabled(m.payload["enabled"].getWithDefault<bool>(false));
+            break;
+    }
+}
+
 //==============================================================================
 choc::value::Value WebViewEditor::handleSetParameterValueEvent(const choc::value::ValueView& e) {
     // When setting a parameter value, we simply tell the host. This will in turn fire
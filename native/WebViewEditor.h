@@ -5,15 +5,23 @@
 
 #include <choc_WebView.h>
 
+#include "MessageBus.h"
+
 
 //==============================================================================
 // A simple juce::AudioProcessorEditor that holds a choc::WebView and sets the
 // WebView instance to cover the entire region of the editor.
-class WebViewEditor : public juce::AudioProcessorEditor
+//
+// While open, it connects to the processor's MessageBus, and once per display frame
+// drains the processor's telemetry and flushes the bus to the WebView in a single
+// call. Messages from the page come back through the same bus.
+class WebViewEditor : public juce::AudioProcessorEditor,
+                      private juce::Timer
 {
 public:
     //==============================================================================
     WebViewEditor(juce::AudioProcessor* proc, juce::File const& assetDirectory, int width, int height);
+    ~WebViewEditor() override;
 
     //==============================================================================
     choc::ui::WebView* getWebViewPtr();
@@ -22,8 +30,15 @@ public:
     void paint (juce::Graphics& g) override;
     void resized() override;
 
+    //==============================================================================
+    /** Implement the Timer interface. */
+    void timerCallback() override;
+
+    static constexpr int kFrameRateHz = 30;
+
 private:
     //==============================================================================
+    void handleMessage(MessageBus::InboundMessage const& m);
     choc::value::Value handleSetParameterValueEvent(const choc::value::ValueView& e);
 
     //==============================================================================
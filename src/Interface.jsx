@@ -2,6 +2,8 @@ import React, { useState } from 'react';
 import { XCircleIcon, XMarkIcon } from '@heroicons/react/20/solid'
 
 import Knob from './Knob.jsx';
+import Meters from './Meters.jsx';
+import ProfilePanel from './ProfilePanel.jsx';
 
 import manifest from '../public/manifest.json';
 
@@ -106,14 +108,21 @@ export default function Interface(props) {
     thumbColor: '#F8FAFC',
   };
 
-  let params = manifest.parameters.map(({paramId, name, min, max, defaultValue}) => {
-    let currentValue = props[paramId] || 0;
+  // Parameter values arrive in their natural range, and the knobs work in [0, 1].
+  // Stepped parameters with labels read out as the label for their current step.
+  let params = manifest.parameters.map(({paramId, name, min, max, defaultValue, step, labels}) => {
+    let currentValue = props[paramId] ?? defaultValue;
+    let normalizedValue = (max > min) ? (currentValue - min) / (max - min) : 0;
+
+    let readout = (labels && step)
+      ? labels[Math.round((currentValue - min) / step)]
+      : `${Math.round(normalizedValue * 100)}%`;
 
     return {
       paramId,
       name,
-      value: currentValue,
-      readout: `${Math.round(currentValue * 100)}%`,
+      value: normalizedValue,
+      readout,
       setValue: (v) => props.requestParamValueUpdate(paramId, v),
     };
   });
@@ -122,13 +131,21 @@ export default function Interface(props) {
     <div className="w-full h-screen min-w-[492px] min-h-[238px] bg-slate-800 bg-mesh p-8">
       <div className="h-1/5 flex justify-between items-center text-md text-slate-400 select-none">
         <Logo className="h-8 w-auto text-slate-100" />
+        <Meters telemetry={props.telemetry} />
         <div>
-          <span className="font-bold">SRVB</span> &middot; {__BUILD_DATE__} &middot; {__COMMIT_HASH__}
+          <span className="font-bold">SRVB</span> &middot; {__BUILD_DATE__} &middot; {__COMMIT_HASH__} &middot;{' '}
+          <button
+            type="button"
+            onClick={() => props.requestProfilingEnabled(!props.profiling)}
+            className={props.profiling ? 'text-pink-500' : 'hover:text-slate-200'}>
+            CPU
+          </button>
         </div>
       </div>
       <div className="flex flex-col h-4/5">
         {props.error && (<ErrorAlert message={props.error.message} reset={props.resetErrorState} />)}
-        <div className="flex flex-1">
+        {props.profiling && (<ProfilePanel profile={props.profile} />)}
+        <div className={props.profiling ? 'hidden' : 'flex flex-1'}>
           {params.map(({name, value, readout, setValue}) => (
             <div key={name} className="flex flex-col flex-1 justify-center items-center">
               <Knob className="h-20 w-20 m-4" value={value} onChange={setValue} {...colorProps} />
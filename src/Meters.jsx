@@ -0,0 +1,66 @@
+import React from 'react';
+
+
+const kFloorDb = -60;
+
+function toMeterWidth(gain) {
+  let db = (gain > 0) ? 20 * Math.log10(gain) : kFloorDb;
+  return `${100 * Math.max(0, Math.min(1, 1 - db / kFloorDb))}%`;
+}
+
+function Meter({label, rms, peak}) {
+  return (
+    <div className="flex items-center">
+      <span className="w-8 text-right mr-2">{label}</span>
+      <div className="relative w-24 h-1.5 rounded bg-slate-700">
+        <div className="absolute h-1.5 rounded bg-pink-500" style={{ width: toMeterWidth(rms) }} />
+        {peak !== undefined && (
+          <div className="absolute h-1.5 w-px bg-slate-100" style={{ left: toMeterWidth(peak) }} />
+        )}
+      </div>
+    </div>
+  );
+}
+
+// Stereo reads as L and R, and anything wider by channel number
+function channelLabel(ch, numChannels) {
+  if (numChannels === 1)
+    return 'M';
+
+  if (numChannels === 2)
+    return ch === 0 ? 'L' : 'R';
+
+  return `${ch + 1}`;
+}
+
+// Output levels, one meter per output channel, the wet network's level, and how long
+// processBlock is taking, from the telemetry the native side sends at display rate.
+// Levels read from -60dBFS to 0dBFS; loads are a fraction of the real time each
+// block covers.
+export default function Meters({telemetry}) {
+  if (!telemetry)
+    return null;
+
+  let {peak, rms, wetRms, load, maxLoad, overruns} = telemetry;
+
+  // Surround and immersive layouts go two to a row, to keep the header short
+  let layout = rms.length > 2 ? 'grid grid-cols-2 gap-x-3 gap-y-1' : 'flex flex-col gap-1';
+
+  return (
+    <div className="flex items-center gap-4 text-xs font-light">
+      <div className="flex flex-col gap-1">
+        <div className={layout}>
+          {rms.map((r, ch) => (
+            <Meter key={ch} label={channelLabel(ch, rms.length)} rms={r} peak={peak[ch]} />
+          ))}
+        </div>
+        <Meter label="Wet" rms={wetRms} />
+      </div>
+      <div className="flex flex-col w-24">
+        <span>DSP {(load * 100).toFixed(1)}%</span>
+        <span>Max {(maxLoad * 100).toFixed(1)}%</span>
+        <span className={overruns > 0 ? 'text-pink-500' : undefined}>{overruns} overruns</span>
+      </div>
+    </div>
+  );
+}
@@ -0,0 +1,63 @@
+import React from 'react';
+
+
+function formatLoad(load) {
+  return `${(load * 100).toFixed(load < 0.01 ? 2 : 1)}%`;
+}
+
+function Bar({load, total}) {
+  let width = (total > 0) ? Math.min(100, 100 * load / total) : 0;
+
+  return (
+    <div className="flex-1 h-1.5 mx-2 rounded bg-slate-700">
+      <div className="h-1.5 rounded bg-pink-500" style={{ width: `${width}%` }} />
+    </div>
+  );
+}
+
+// A live breakdown of where the real-time thread spends its time, as sent by the
+// native profiler. Loads are fractions of real time, so 100% would be a whole core.
+//
+// Groups are named subgraphs, by key prefix, and "elementary" is everything the
+// runtime spent outside of our own native nodes. Entries are individual nodes, and
+// the stages within them, as "<node>/<stage>".
+export default function ProfilePanel({profile}) {
+  if (!profile) {
+    return (
+      <div className="flex flex-1 justify-center items-center text-sm text-slate-400 font-light">
+        Collecting a profile...
+      </div>
+    );
+  }
+
+  let groups = [...profile.groups].sort((a, b) => b.load - a.load);
+  let entries = [...profile.entries].sort((a, b) => b.load - a.load);
+
+  return (
+    <div className="flex flex-1 gap-8 overflow-y-auto text-xs text-slate-300 font-light select-none">
+      <div className="flex-1">
+        <div className="flex justify-between mb-2 text-sm text-slate-50">
+          <span>Total</span>
+          <span className="text-pink-500">{formatLoad(profile.load)}</span>
+        </div>
+        {groups.map(({name, load}) => (
+          <div key={name} className="flex items-center mb-1">
+            <span className="w-20 truncate">{name}</span>
+            <Bar load={load} total={profile.load} />
+            <span className="w-12 text-right">{formatLoad(load)}</span>
+          </div>
+        ))}
+      </div>
+      <div className="flex-[2]">
+        {entries.map(({name, load, nsPerCall}) => (
+          <div key={name} className="flex items-center mb-1">
+            <span className="w-40 truncate" title={name}>{name}</span>
+            <Bar load={load} total={profile.load} />
+            <span className="w-12 text-right">{formatLoad(load)}</span>
+            <span className="w-20 text-right text-slate-400">{(nsPerCall / 1000).toFixed(1)}&micro;s/block</span>
+          </div>
+        ))}
+      </div>
+    </div>
+  );
+}
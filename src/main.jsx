@@ -15,44 +15,110 @@ const useStore = createHooks(store);
 const errorStore = createStore(() => ({ error: null }));
 const useErrorStore = createHooks(errorStore);
 
+const profileStore = createStore(() => ({ profiling: false, profile: null }));
+const useProfileStore = createHooks(profileStore);
+
+const telemetryStore = createStore(() => ({ telemetry: null }));
+const useTelemetryStore = createHooks(telemetryStore);
+
 // Interop bindings
-function requestParamValueUpdate(paramId, value) {
-  if (typeof globalThis.__postNativeMessage__ === 'function') {
-    globalThis.__postNativeMessage__("setParameterValue", {
-      paramId,
-      value,
-    });
+//
+// Messages for the native side go out together, at most once per animation frame,
+// and a message posted with a key replaces any still waiting with the same key, so
+// that a knob drag only ever sends its latest value.
+let outbox = [];
+let outboxScheduled = false;
+
+function flushNativeMessages() {
+  outboxScheduled = false;
+
+  const messages = outbox.map(({type, payload}) => ({ type, payload }));
+  outbox = [];
+
+  if (typeof globalThis.__postNativeMessages__ === 'function') {
+    globalThis.__postNativeMessages__(messages);
+  }
+}
+
+function postNativeMessage(type, payload, key) {
+  if (key !== undefined) {
+    outbox = outbox.filter((m) => m.key !== key);
+  }
+
+  outbox.push({ type, payload, key });
+
+  if (!outboxScheduled) {
+    outboxScheduled = true;
+    requestAnimationFrame(flushNativeMessages);
   }
 }
 
+function requestParamValueUpdate(paramId, value) {
+  postNativeMessage("setParameterValue", { paramId, value }, `param:${paramId}`);
+}
+
+function requestProfilingEnabled(enabled) {
+  profileStore.setState({ profiling: enabled, profile: null });
+  postNativeMessage("setProfilingEnabled", { enabled }, "profiling");
+}
+
 if (process.env.NODE_ENV !== 'production') {
   import.meta.hot.on('reload-dsp', () => {
     console.log('Sending reload dsp message');
-
-    if (typeof globalThis.__postNativeMessage__ === 'function') {
-      globalThis.__postNativeMessage__('reload');
-    }
+    postNativeMessage('reload');
   });
 }
 
-globalThis.__receiveStateChange__ = function(state) {
-  store.setState(JSON.parse(state));
-};
+// Everything from the native side arrives here, once per display frame, as one batch:
+// only the state keys that changed, which setState merges for us, any errors and
+// forwarded engine logs, and the latest profile and telemetry, coalesced over every
+// block since the last frame
+globalThis.__receiveNativeMessages__ = function(batch) {
+  if (batch.state) {
+    store.setState(batch.state);
+  }
 
-globalThis.__receiveError__ = (err) => {
-  errorStore.setState({ error: err });
+  if (batch.errors && batch.errors.length > 0) {
+    const {name, message} = batch.errors[batch.errors.length - 1];
+    const error = new Error(message);
+    error.name = name;
+
+    errorStore.setState({ error });
+  }
+
+  for (const args of batch.logs ?? []) {
+    console.log(...args);
+  }
+
+  if (batch.droppedLogs) {
+    console.warn(`[embedded] ${batch.droppedLogs} log messages dropped`);
+  }
+
+  if (batch.profile) {
+    profileStore.setState({ profile: batch.profile });
+  }
+
+  if (batch.telemetry) {
+    telemetryStore.setState({ telemetry: batch.telemetry });
+  }
 };
 
 // Mount the interface
 function App(props) {
   let state = useStore();
   let {error} = useErrorStore();
+  let {profiling, profile} = useProfileStore();
+  let {telemetry} = useTelemetryStore();
 
   return (
     <Interface
       {...state}
       error={error}
+      profiling={profiling}
+      profile={profile}
+      telemetry={telemetry}
       requestParamValueUpdate={requestParamValueUpdate}
+      requestProfilingEnabled={requestProfilingEnabled}
       resetErrorState={() => errorStore.setState({ error: null })} />
   );
 }
@@ -64,6 +130,4 @@ ReactDOM.createRoot(document.getElementById('root')).render(
 )
 
 // Request initial processor state
-if (typeof globalThis.__postNativeMessage__ === 'function') {
-  globalThis.__postNativeMessage__("ready");
-}
+postNativeMessage("ready");